@@ -7,16 +7,31 @@
  */
 
 #include <ctype.h>
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
+#include <hardware/uart.h>
 #include <pico/stdlib.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "protocol.h"
 #include "settings.h"
+#include "settings_flash.h"
 
 // Maximum buffer size for command input
 enum { INPUT_BUFFER_SIZE = 128 };
 
-enum { TIMEOUT_DURATION_US = 1000, VALUE_STR_SIZE = 8, COMMAND_SIZE = 64 };
+enum { FRAME_POLL_MS = 1, VALUE_STR_SIZE = 8, COMMAND_SIZE = 64 };
+
+// Size of the input ring buffer filled from the stdio interrupt and, while the
+// flash is written, by DMA. Must be a power of two, 1 << INPUT_RING_BITS. It
+// holds the input of a whole save of the settings of the CLI: about 90 ms of
+// continuous input at 115200 baud
+enum { INPUT_RING_SIZE = 1024, INPUT_RING_BITS = 10 };
+
+// Maximum number of settings in a single import, and bytes of their values
+enum { IMPORT_MAX_ENTRIES = 64, IMPORT_VALUES_SIZE = 2048 };
 
 enum {
   SETTINGS_ADDRESS = 0x1FF000,
@@ -25,6 +40,26 @@ enum {
   VERSION_NUMBER = 0x0001
 };
 
+// Benchmark. The synthetic store lives in its own region, right below the
+// settings of the CLI, so they are not touched
+enum {
+  BENCH_ADDRESS = 0x1F7000,
+  BENCH_MAX_SIZE = SETTINGS_ADDRESS - BENCH_ADDRESS,
+  BENCH_MAGIC_NUMBER = 0x4BE5,
+  BENCH_DEFAULT_ENTRIES = 32,
+  BENCH_MIN_ENTRIES = 3,  // One of each type
+  BENCH_DEFAULT_ITERATIONS = 100,
+  BENCH_MAX_ITERATIONS = 1000,
+  BENCH_MAX_SAVES = 10  // Every save erases the region: keep them few
+};
+
+// Settings of the CLI
+static const SettingsConfigEntry defaultEntries[] = {
+    {"TEST1", SETTINGS_TYPE_STRING, "TEST PARAM 1"},
+    {"TEST2", SETTINGS_TYPE_BOOL, "false"},
+    {"TEST3", SETTINGS_TYPE_INT, "60"},
+    {"TEST4", SETTINGS_TYPE_STRING, "TEST PARAM 4"}};
+
 // Command lookup structure, now with argument support
 typedef struct {
   const char *command;
@@ -40,6 +75,8 @@ void cmdGet(const char *arg);
 void cmdPutInt(const char *arg);
 void cmdPutBool(const char *arg);
 void cmdPutString(const char *arg);
+void cmdImport(const char *arg);
+void cmdBench(const char *arg);
 void cmdUnknown(const char *arg);
 
 // Command table
@@ -47,7 +84,8 @@ const Command commands[] = {
     {"help", cmdHelp},        {"print", cmdPrint},
     {"save", cmdSave},        {"erase", cmdErase},
     {"get", cmdGet},          {"put_int", cmdPutInt},
-    {"put_bool", cmdPutBool}, {"put_string", cmdPutString}};
+    {"put_bool", cmdPutBool}, {"put_string", cmdPutString},
+    {"import", cmdImport},    {"bench", cmdBench}};
 
 // Number of commands in the table
 const size_t numCommands = sizeof(commands) / sizeof(commands[0]);
@@ -63,6 +101,8 @@ void cmdHelp(const char *arg) {
   DPRINTF("  put_int - Set an integer setting (requires a key and value)\n");
   DPRINTF("  put_bool- Set a boolean setting (requires a key and value)\n");
   DPRINTF("  put_string - Set a string setting (requires a key and value)\n");
+  DPRINTF("  import  - Set many settings, one KEY=VALUE per line, and save\n");
+  DPRINTF("  bench   - Measure the library ([entries] [iterations])\n");
 }
 
 void cmdPrint(const char *arg) { settings_print(); }
@@ -172,6 +212,332 @@ void cmdPutString(const char *arg) {
   }
 }
 
+// Import mode. Every line is a KEY=VALUE pair of a known key, staged as the
+// entry of its key and its value. When the import ends, the staged lines are
+// fed to the INI loader of the library, which converts and validates the
+// values, and the settings are saved once.
+typedef struct {
+  const SettingsConfigEntry *entry;  // Entry of the key
+  uint16_t value;                    // Offset of the value in importValues
+  uint16_t line;                     // Line of the import
+} ImportEntry;
+
+static ImportEntry importEntries[IMPORT_MAX_ENTRIES];
+static char importValues[IMPORT_VALUES_SIZE];
+static size_t importValuesUsed = 0;
+static size_t importCount = 0;
+static int importLine = 0;
+static int importErrors = 0;
+static bool importMode = false;
+
+void cmdImport(const char *arg) {
+  importMode = true;
+  importCount = 0;
+  importValuesUsed = 0;
+  importLine = 0;
+  importErrors = 0;
+  DPRINTF("Import mode. One KEY=VALUE per line, up to %d settings.\n",
+          IMPORT_MAX_ENTRIES);
+  DPRINTF("End with '.' to apply and save, or 'abort' to discard.\n");
+}
+
+static void importError(int line, const char *message, const char *key) {
+  importErrors++;
+  DPRINTF("Line %d: %s%s%s\n", line, message, key ? ": " : "",
+          key ? key : "");
+}
+
+// Stage a KEY=VALUE line of a known key. The value is checked when applied
+static void importStage(const char *line) {
+  const char *separator = strchr(line, '=');
+  if (separator == NULL) {
+    importError(importLine, "Expected KEY=VALUE", NULL);
+    return;
+  }
+
+  // Trim the spaces around the key
+  const char *keyStart = line;
+  while (isspace((unsigned char)*keyStart)) {
+    keyStart++;
+  }
+  const char *keyEnd = separator;
+  while (keyEnd > keyStart && isspace((unsigned char)keyEnd[-1])) {
+    keyEnd--;
+  }
+  if (keyEnd == keyStart || keyEnd - keyStart >= SETTINGS_MAX_KEY_LENGTH) {
+    importError(importLine, "Invalid key length", NULL);
+    return;
+  }
+  char key[SETTINGS_MAX_KEY_LENGTH] = {0};
+  memcpy(key, keyStart, keyEnd - keyStart);
+
+  const SettingsConfigEntry *entry = settings_find_entry(key);
+  if (entry == NULL) {
+    importError(importLine, "Unknown key", key);
+    return;
+  }
+  // One value per line for the INI loader: end it at any line break
+  size_t valueSize = strcspn(separator + 1, "\r\n") + 1;
+  if (importCount == IMPORT_MAX_ENTRIES ||
+      valueSize > IMPORT_VALUES_SIZE - importValuesUsed) {
+    importError(importLine, "Too many settings in one import", key);
+    return;
+  }
+  ImportEntry *staged = &importEntries[importCount++];
+  staged->entry = entry;
+  staged->value = (uint16_t)importValuesUsed;
+  staged->line = (uint16_t)importLine;
+  memcpy(importValues + importValuesUsed, separator + 1, valueSize - 1);
+  importValues[importValuesUsed + valueSize - 1] = '\0';
+  importValuesUsed += valueSize;
+}
+
+// Position of the INI loader in the staged lines
+typedef struct {
+  size_t entry;
+  size_t offset;
+} ImportReader;
+
+// Read callback of the INI loader: the staged settings, one KEY=VALUE line
+// each
+static int importRead(uint8_t *buffer, size_t size, void *ctx) {
+  ImportReader *reader = (ImportReader *)ctx;
+  size_t len = 0;
+  while (len < size && reader->entry < importCount) {
+    const ImportEntry *staged = &importEntries[reader->entry];
+    char line[SETTINGS_MAX_KEY_LENGTH + INPUT_BUFFER_SIZE + 2];
+    size_t lineLen = (size_t)snprintf(line, sizeof(line), "%s=%s\n",
+                                      staged->entry->key,
+                                      importValues + staged->value);
+    size_t chunk = lineLen - reader->offset;
+    chunk = chunk < size - len ? chunk : size - len;
+    memcpy(buffer + len, line + reader->offset, chunk);
+    len += chunk;
+    reader->offset += chunk;
+    if (reader->offset == lineLen) {
+      reader->entry++;
+      reader->offset = 0;
+    }
+  }
+  return (int)len;
+}
+
+// Error callback of the INI loader, with the line of the import
+static void importIniError(unsigned line, const char *message, void *ctx) {
+  importError(importEntries[line - 1].line, message, NULL);
+}
+
+// Apply every staged setting and save them with a single write to flash
+static void importApply() {
+  ImportReader reader = {0};
+  int skipped = settings_load_ini(importRead, importIniError, &reader);
+  int applied = (int)importCount - (skipped > 0 ? skipped : 0);
+  int err = skipped < 0 ? skipped : applied > 0 ? settings_save() : 0;
+  if (err != 0) {
+    DPRINTF("Imported %d settings with %d errors. Cannot save them (%d).\n",
+            applied, importErrors, err);
+    return;
+  }
+  DPRINTF("Imported %d settings with %d errors.%s\n", applied, importErrors,
+          applied > 0 ? " Saved." : "");
+}
+
+void processImportLine(const char *input) {
+  importLine++;
+  if (strcmp(input, ".") == 0) {
+    importApply();
+    importMode = false;
+  } else if (strcmp(input, "abort") == 0) {
+    DPRINTF("Import aborted. Nothing changed.\n");
+    importMode = false;
+  } else {
+    importStage(input);
+  }
+}
+
+// Benchmark. A synthetic store of BENCH<n> keys, cycling the three types, is
+// created in BENCH_ADDRESS and every operation is timed with time_us_64. The
+// results are printed as CSV, one row per operation, with printf so they are
+// also printed in release builds. Debug builds time the DPRINTF calls too
+static uint32_t benchSamples[BENCH_MAX_ITERATIONS];
+
+static void initSettings() {
+  settings_init(defaultEntries,
+                sizeof(defaultEntries) / sizeof(defaultEntries[0]),
+                SETTINGS_ADDRESS, BUFFER_SIZE, MAGIC_NUMBER, VERSION_NUMBER);
+}
+
+static int compareSamples(const void *a, const void *b) {
+  uint32_t left = *(const uint32_t *)a;
+  uint32_t right = *(const uint32_t *)b;
+  return (left > right) - (left < right);
+}
+
+// Print the distribution of the samples as a CSV row
+static void benchReport(const char *op, uint16_t numEntries, size_t count) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < count; i++) {
+    total += benchSamples[i];
+  }
+  qsort(benchSamples, count, sizeof(benchSamples[0]), compareSamples);
+  printf("%s,%u,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", op, numEntries,
+         (unsigned)count, benchSamples[0], benchSamples[count / 2],
+         benchSamples[count * 90 / 100], benchSamples[count * 99 / 100],
+         benchSamples[count - 1], (uint32_t)(total / count),
+         clock_get_hz(clk_sys));
+}
+
+// Key of a random entry of the given type. Types cycle every three entries
+static void benchKey(char *key, uint16_t numEntries, int type) {
+  int index = (rand() % (numEntries / BENCH_MIN_ENTRIES)) * BENCH_MIN_ENTRIES +
+              type;
+  snprintf(key, SETTINGS_MAX_KEY_LENGTH, "BENCH%d", index);
+}
+
+static void benchRun(const SettingsConfigEntry *benchEntries,
+                     uint16_t numEntries, uint32_t flashSize,
+                     size_t iterations) {
+  static const SettingsDataType types[] = {
+      SETTINGS_TYPE_INT, SETTINGS_TYPE_BOOL, SETTINGS_TYPE_STRING};
+  char key[SETTINGS_MAX_KEY_LENGTH];
+  char value[SETTINGS_MAX_VALUE_LENGTH];
+  uint64_t start;
+
+  for (size_t i = 0; i < iterations; i++) {
+    benchKey(key, numEntries, rand() % BENCH_MIN_ENTRIES);
+    start = time_us_64();
+    settings_find_entry(key);
+    benchSamples[i] = (uint32_t)(time_us_64() - start);
+  }
+  benchReport("find_hit", numEntries, iterations);
+
+  for (size_t i = 0; i < iterations; i++) {
+    start = time_us_64();
+    settings_find_entry("BENCH_MISSING");
+    benchSamples[i] = (uint32_t)(time_us_64() - start);
+  }
+  benchReport("find_miss", numEntries, iterations);
+
+  for (size_t t = 0; t < BENCH_MIN_ENTRIES; t++) {
+    for (size_t i = 0; i < iterations; i++) {
+      // Every put changes the value, so none of them is skipped
+      benchKey(key, numEntries, t);
+      snprintf(value, sizeof(value), "Value %u", (unsigned)i);
+      start = time_us_64();
+      switch (types[t]) {
+        case SETTINGS_TYPE_INT:
+          settings_put_integer(key, (int)i);
+          break;
+        case SETTINGS_TYPE_BOOL:
+          settings_put_bool(key, i & 1);
+          break;
+        default:
+          settings_put_string(key, value);
+          break;
+      }
+      benchSamples[i] = (uint32_t)(time_us_64() - start);
+    }
+    benchReport(types[t] == SETTINGS_TYPE_INT    ? "put_int"
+                : types[t] == SETTINGS_TYPE_BOOL ? "put_bool"
+                                                 : "put_string",
+                numEntries, iterations);
+  }
+
+  size_t saves = iterations < BENCH_MAX_SAVES ? iterations : BENCH_MAX_SAVES;
+  uint32_t irqOffUs[BENCH_MAX_SAVES];
+  for (size_t i = 0; i < saves; i++) {
+    benchKey(key, numEntries, 0);
+    settings_put_integer(key, (int)i);  // Something to save
+    start = time_us_64();
+    settings_save();
+    benchSamples[i] = (uint32_t)(time_us_64() - start);
+    SettingsStats stats;
+    settings_get_stats(&stats);
+    irqOffUs[i] = stats.lastSaveIrqOffUs;
+  }
+  benchReport("save", numEntries, saves);
+  memcpy(benchSamples, irqOffUs, saves * sizeof(irqOffUs[0]));
+  benchReport("save_irq_off", numEntries, saves);
+
+  // The store is in flash now, so every init loads it
+  for (size_t i = 0; i < iterations; i++) {
+    start = time_us_64();
+    settings_init(benchEntries, numEntries, BENCH_ADDRESS, flashSize,
+                  BENCH_MAGIC_NUMBER, VERSION_NUMBER);
+    benchSamples[i] = (uint32_t)(time_us_64() - start);
+  }
+  benchReport("init", numEntries, iterations);
+}
+
+// Check if any setting of the CLI changed since it was loaded or saved
+static bool settingsUnsaved() {
+  SettingsIterator iter;
+  settings_iter_begin(&iter, NULL);
+  settings_iter_filter(&iter, SETTINGS_FILTER_DIRTY);
+  return settings_iter_next(&iter) != NULL;
+}
+
+void cmdBench(const char *arg) {
+  // The settings of the CLI are loaded again from flash when the bench ends
+  if (settingsUnsaved()) {
+    DPRINTF("Unsaved changes. Save them before running the bench.\n");
+    return;
+  }
+
+  // Room for the entries and the magic entry
+  const unsigned maxEntries = BENCH_MAX_SIZE / sizeof(SettingsConfigEntry) - 1;
+  unsigned numEntries = BENCH_DEFAULT_ENTRIES;
+  unsigned iterations = BENCH_DEFAULT_ITERATIONS;
+  sscanf(arg, "%u %u", &numEntries, &iterations);
+  if (numEntries < BENCH_MIN_ENTRIES || numEntries > maxEntries ||
+      iterations == 0 || iterations > BENCH_MAX_ITERATIONS) {
+    DPRINTF("Usage: bench [entries %d-%u] [iterations 1-%d]\n",
+            BENCH_MIN_ENTRIES, maxEntries, BENCH_MAX_ITERATIONS);
+    return;
+  }
+
+  SettingsConfigEntry *benchEntries =
+      (SettingsConfigEntry *)calloc(numEntries, sizeof(SettingsConfigEntry));
+  if (benchEntries == NULL) {
+    DPRINTF("Not enough memory for %u entries.\n", numEntries);
+    return;
+  }
+  for (unsigned i = 0; i < numEntries; i++) {
+    SettingsConfigEntry *entry = &benchEntries[i];
+    snprintf(entry->key, sizeof(entry->key), "BENCH%u", i);
+    switch (i % BENCH_MIN_ENTRIES) {
+      case 0:
+        entry->dataType = SETTINGS_TYPE_INT;
+        snprintf(entry->value, sizeof(entry->value), "%u", i);
+        break;
+      case 1:
+        entry->dataType = SETTINGS_TYPE_BOOL;
+        strcpy(entry->value, "false");
+        break;
+      default:
+        entry->dataType = SETTINGS_TYPE_STRING;
+        snprintf(entry->value, sizeof(entry->value), "Bench value %u", i);
+        break;
+    }
+  }
+
+  // Smallest region, in whole sectors, that fits the store
+  uint32_t flashSize = (numEntries + 1) * sizeof(SettingsConfigEntry);
+  flashSize = (flashSize + SETTINGS_FLASH_PAGE_SIZE - 1) /
+              SETTINGS_FLASH_PAGE_SIZE * SETTINGS_FLASH_PAGE_SIZE;
+
+  settings_init(benchEntries, numEntries, BENCH_ADDRESS, flashSize,
+                BENCH_MAGIC_NUMBER, VERSION_NUMBER);
+  printf(
+      "op,entries,samples,min_us,p50_us,p90_us,p99_us,max_us,mean_us,"
+      "clk_sys_hz\n");
+  benchRun(benchEntries, numEntries, flashSize, iterations);
+  free(benchEntries);
+
+  // Back to the settings of the CLI
+  initSettings();
+}
+
 void cmdUnknown(const char *arg) {
   DPRINTF("Unknown command. Type 'help' for a list of commands.\n");
 }
@@ -191,6 +557,113 @@ void processCommand(const char *input) {
   }
   cmdUnknown(NULL);  // If no command matches
 }
+// Input ring buffer. The head is only written by the interrupt and by the
+// flash lockout, with the interrupts disabled, and the tail only by the main
+// loop, so no lock is needed. Aligned to its size so the DMA wraps around it
+static volatile uint8_t inputRing[INPUT_RING_SIZE]
+    __attribute__((aligned(INPUT_RING_SIZE)));
+static volatile uint32_t inputRingHead = 0;
+static volatile uint32_t inputRingTail = 0;
+static volatile uint32_t inputRingDropped = 0;
+
+// Called from the stdio interrupt when characters are available. Reading them
+// here keeps the UART FIFO empty while the main loop is busy, for example
+// saving the settings
+static void onCharsAvailable(void *param) {
+  int character;
+  while ((character = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+    uint32_t head = inputRingHead;
+    if (head - inputRingTail == INPUT_RING_SIZE) {
+      inputRingDropped++;  // Full: the main loop is not keeping up
+      continue;
+    }
+    inputRing[head & (INPUT_RING_SIZE - 1)] = (uint8_t)character;
+    inputRingHead = head + 1;
+  }
+}
+
+// While the flash is erased or programmed the interrupts are disabled, for at
+// least a whole sector erase: far longer than the 32 characters of the UART
+// FIFO last at 115200 baud. The lockout of the flash scheduler starts a DMA
+// channel that drains the FIFO into the free space of the ring, and the
+// interrupt takes over again when the window ends
+static int inputDmaChannel = -1;
+static uint32_t inputDmaRoom = 0;
+
+static uint32_t inputLockEnter(void *ctx) {
+  uint32_t ints = save_and_disable_interrupts();
+  uint32_t head = inputRingHead;
+  inputDmaRoom = INPUT_RING_SIZE - (head - inputRingTail);
+  if (inputDmaRoom > 0) {
+    dma_channel_set_write_addr(inputDmaChannel,
+                               &inputRing[head & (INPUT_RING_SIZE - 1)], false);
+    dma_channel_set_trans_count(inputDmaChannel, inputDmaRoom, true);
+  }
+  return ints;
+}
+
+static void inputLockExit(uint32_t ints, void *ctx) {
+  if (inputDmaRoom > 0) {
+    // Stop the channel before reading how many characters it moved
+    hw_clear_bits(&dma_channel_hw_addr(inputDmaChannel)->al1_ctrl,
+                  DMA_CH0_CTRL_TRIG_EN_BITS);
+    uint32_t received =
+        inputDmaRoom - dma_channel_hw_addr(inputDmaChannel)->transfer_count;
+    dma_channel_abort(inputDmaChannel);
+    hw_set_bits(&dma_channel_hw_addr(inputDmaChannel)->al1_ctrl,
+                DMA_CH0_CTRL_TRIG_EN_BITS);
+    inputRingHead += received;
+  }
+  restore_interrupts(ints);
+}
+
+static const SettingsFlashLockOps inputLockOps = {.enter = inputLockEnter,
+                                                  .exit = inputLockExit};
+
+// Receive the UART by DMA during the flash lockout windows. Without a free
+// channel the input received during a save may be lost
+static void inputDmaInit() {
+  inputDmaChannel = dma_claim_unused_channel(false);
+  if (inputDmaChannel < 0) {
+    DPRINTF("WARNING: No DMA channel for the input during saves.\n");
+    return;
+  }
+  dma_channel_config config = dma_channel_get_default_config(inputDmaChannel);
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+  channel_config_set_read_increment(&config, false);
+  channel_config_set_write_increment(&config, true);
+  channel_config_set_ring(&config, true, INPUT_RING_BITS);
+  channel_config_set_dreq(&config, uart_get_dreq(uart_default, false));
+  dma_channel_configure(inputDmaChannel, &config, inputRing,
+                        &uart_get_hw(uart_default)->dr, 0, false);
+  settings_flash_set_lock(&inputLockOps, NULL);
+}
+
+// Next character of the input, or PICO_ERROR_TIMEOUT if there is none
+static int inputRingPop() {
+  uint32_t tail = inputRingTail;
+  if (tail == inputRingHead) {
+    return PICO_ERROR_TIMEOUT;
+  }
+  int character = inputRing[tail & (INPUT_RING_SIZE - 1)];
+  inputRingTail = tail + 1;
+  return character;
+}
+
+// Sleep until there is input. Interrupts are masked while checking the ring so
+// a character arriving right before __wfi() still wakes the core up
+static void waitForInput() {
+  if (protocolBusy()) {
+    sleep_ms(FRAME_POLL_MS);  // Wake up to check the frame timeout
+    return;
+  }
+  uint32_t ints = save_and_disable_interrupts();
+  if (inputRingTail == inputRingHead) {
+    __wfi();
+  }
+  restore_interrupts(ints);
+}
+
 int main() {
   stdio_init_all();  // Initialize standard I/O for USB or UART
   setvbuf(stdout, NULL, _IONBF,
@@ -202,28 +675,34 @@ int main() {
   DPRINTF("RP - Settings CLI Tool\n");
   DPRINTF("Type 'help' for a list of commands.\n");
 
-  SettingsConfigEntry entries[] = {
-      {"TEST1", SETTINGS_TYPE_STRING, "TEST PARAM 1"},
-      {"TEST2", SETTINGS_TYPE_BOOL, "false"},
-      {"TEST3", SETTINGS_TYPE_INT, "60"},
-      {"TEST4", SETTINGS_TYPE_STRING, "TEST PARAM 4"}};
+  initSettings();
 
-  settings_init(entries, sizeof(entries) / sizeof(entries[0]), SETTINGS_ADDRESS,
-                BUFFER_SIZE, MAGIC_NUMBER, VERSION_NUMBER);
+  // Input is read from the interrupt from now on, and by DMA while the flash
+  // is written
+  inputDmaInit();
+  stdio_set_chars_available_callback(onCharsAvailable, NULL);
 
   DPRINTF("> ");  // Print the prompt
   while (true) {
-    int character = getchar_timeout_us(
-        TIMEOUT_DURATION_US);  // Read a character with timeout
-    if (character != PICO_ERROR_TIMEOUT) {
-      if (character == '\r' || character == '\n') {
+    int character = inputRingPop();  // Read a character, if any
+    protocolPoll();  // Drop binary frames that stopped arriving
+    if (character == PICO_ERROR_TIMEOUT) {
+      waitForInput();  // Sleep until the next interrupt
+    } else {
+      if (protocolBusy() || (inputPos == 0 && character == PROTOCOL_SOF)) {
+        protocolFeed((uint8_t)character);  // Binary frame of a host tool
+      } else if (character == '\r' || character == '\n') {
         // When Enter is pressed, process the command
         if (inputPos > 0) {
           printf("\n");                  // Print a newline
           inputBuffer[inputPos] = '\0';  // Null-terminate the string
-          processCommand(inputBuffer);   // Process the input command
-          inputPos = 0;                  // Reset buffer position
-          DPRINTF("> ");                 // Print the prompt
+          if (importMode) {
+            processImportLine(inputBuffer);  // One KEY=VALUE of an import
+          } else {
+            processCommand(inputBuffer);  // Process the input command
+          }
+          inputPos = 0;                           // Reset buffer position
+          DPRINTF("%s", importMode ? ". " : "> ");  // Print the prompt
         }
       } else if (inputPos < INPUT_BUFFER_SIZE - 1) {
         putchar(character);  // Echo the character back to the terminal
@@ -231,7 +710,13 @@ int main() {
       }
     }
 
-    // Optionally add other code to run in the main loop here
+    if (inputRingDropped > 0) {
+      DPRINTF("\nWARNING: %lu input characters lost.\n", inputRingDropped);
+      inputRingDropped = 0;
+    }
+
+    // Optionally add other code to run in the main loop here. Code that must
+    // run periodically needs an interrupt to wake the core up
   }
 
   return 0;
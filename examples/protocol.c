@@ -0,0 +1,361 @@
+/**
+ * File: protocol.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Framed binary protocol of the settings CLI, for host tools
+ */
+
+#include "protocol.h"
+
+#include <pico/stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "settings.h"
+
+enum {
+  FRAME_LENGTH_SIZE = 2,
+  FRAME_HEADER_SIZE = 3,  // Length and opcode, covered by the CRC
+  FRAME_CRC_SIZE = 4,
+  RECORD_HEADER_SIZE = 2,  // Type and key length
+  BYTE_BITS = 8
+};
+
+// Receive state
+typedef enum {
+  RX_IDLE = 0,
+  RX_HEADER,
+  RX_PAYLOAD,
+  RX_CRC,
+  RX_DISCARD  // Rest of a frame too long to be received
+} RxState;
+
+static RxState rxState = RX_IDLE;
+static uint8_t rxHeader[FRAME_HEADER_SIZE];
+static uint8_t rxPayload[PROTOCOL_MAX_PAYLOAD];
+static uint8_t rxCrc[FRAME_CRC_SIZE];
+static size_t rxPos = 0;
+static size_t rxLength = 0;
+static uint64_t rxLastByteUs = 0;
+
+// Response being built. It is sent in several frames if it does not fit
+static uint8_t txPayload[PROTOCOL_MAX_PAYLOAD];
+static size_t txLength = 0;
+static uint8_t txOpcode = 0;
+
+static uint32_t readLe(const uint8_t *src, size_t len) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < len; i++) {
+    value |= (uint32_t)src[i] << (BYTE_BITS * i);
+  }
+  return value;
+}
+
+static void writeLe(uint8_t *dest, uint32_t value, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    dest[i] = (uint8_t)(value >> (BYTE_BITS * i));
+  }
+}
+
+// Write raw bytes: putchar() would translate '\n' to "\r\n"
+static void sendBytes(const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    putchar_raw(data[i]);
+  }
+}
+
+static void sendFrame(uint8_t status, const uint8_t *data, size_t len) {
+  uint8_t header[1 + FRAME_HEADER_SIZE + 1] = {PROTOCOL_SOF};
+  writeLe(&header[1], (uint32_t)(len + 1), FRAME_LENGTH_SIZE);
+  header[1 + FRAME_LENGTH_SIZE] = txOpcode | PROTOCOL_RESPONSE_FLAG;
+  header[1 + FRAME_HEADER_SIZE] = status;
+  uint32_t crc = settings_crc32(0, &header[1], sizeof(header) - 1);
+  crc = settings_crc32(crc, data, len);
+  uint8_t crcBytes[FRAME_CRC_SIZE];
+  writeLe(crcBytes, crc, FRAME_CRC_SIZE);
+
+  sendBytes(header, sizeof(header));
+  sendBytes(data, len);
+  sendBytes(crcBytes, sizeof(crcBytes));
+}
+
+// Add data to the response, sending full frames as needed. The status byte
+// takes one byte of every frame
+static void responseAppend(const void *data, size_t len) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  while (len > 0) {
+    size_t room = PROTOCOL_MAX_PAYLOAD - 1 - txLength;
+    size_t chunk = len < room ? len : room;
+    memcpy(&txPayload[txLength], bytes, chunk);
+    txLength += chunk;
+    bytes += chunk;
+    len -= chunk;
+    if (txLength == PROTOCOL_MAX_PAYLOAD - 1) {
+      sendFrame(PROTOCOL_STATUS_MORE, txPayload, txLength);
+      txLength = 0;
+    }
+  }
+}
+
+static void responseEnd(uint8_t status) {
+  sendFrame(status, txPayload, txLength);
+  txLength = 0;
+}
+
+static void responseAppendRecord(const SettingsConfigEntry *entry,
+                                 const char *key, size_t keyLen) {
+  uint8_t header[RECORD_HEADER_SIZE] = {
+      entry ? (uint8_t)entry->dataType : PROTOCOL_UNKNOWN_TYPE,
+      (uint8_t)keyLen};
+  responseAppend(header, sizeof(header));
+  responseAppend(key, keyLen);
+  uint8_t valueLen = 0;
+  if (entry) {
+    valueLen = (uint8_t)strnlen(entry->value, SETTINGS_MAX_VALUE_LENGTH - 1);
+  }
+  responseAppend(&valueLen, 1);
+  if (entry) {
+    responseAppend(entry->value, valueLen);
+  }
+}
+
+static int exportSink(const uint8_t *data, size_t len, void *ctx) {
+  responseAppend(data, len);
+  return 0;
+}
+
+static void opPing() {
+  uint8_t version = PROTOCOL_VERSION;
+  responseAppend(&version, 1);
+  responseEnd(PROTOCOL_STATUS_OK);
+}
+
+// Keys not found are answered with PROTOCOL_UNKNOWN_TYPE and no value
+static void opGet(const uint8_t *payload, size_t len) {
+  size_t pos = 0;
+  while (pos < len) {
+    size_t keyLen = payload[pos++];
+    if (keyLen == 0 || keyLen >= SETTINGS_MAX_KEY_LENGTH ||
+        pos + keyLen > len) {
+      txLength = 0;
+      responseEnd(PROTOCOL_STATUS_BAD_FRAME);
+      return;
+    }
+    char key[SETTINGS_MAX_KEY_LENGTH] = {0};
+    memcpy(key, &payload[pos], keyLen);
+    pos += keyLen;
+    responseAppendRecord(settings_find_entry(key), key, keyLen);
+  }
+  responseEnd(PROTOCOL_STATUS_OK);
+}
+
+static int putRecord(SettingsDataType type, const char *key,
+                     const char *value) {
+  switch (type) {
+    case SETTINGS_TYPE_INT: {
+      char *end = NULL;
+      long number = strtol(value, &end, SETTINGS_BASE_10);
+      if (end == value || *end != '\0' || number < INT_MIN ||
+          number > INT_MAX) {
+        return -1;
+      }
+      return settings_put_integer(key, (int)number);
+    }
+    case SETTINGS_TYPE_BOOL:
+      // Booleans travel as they are stored
+      if (strcmp(value, "true") != 0 && strcmp(value, "false") != 0) {
+        return -1;
+      }
+      return settings_put_bool(key, strcmp(value, "true") == 0);
+    case SETTINGS_TYPE_STRING:
+      return settings_put_string(key, value);
+    default:
+      return -1;
+  }
+}
+
+// Records are applied in order. Values are never truncated: a value too long
+// for an entry is counted as failed
+static void opPut(const uint8_t *payload, size_t len) {
+  uint16_t applied = 0;
+  uint16_t failed = 0;
+  size_t pos = 0;
+  while (pos < len) {
+    if (pos + RECORD_HEADER_SIZE > len) {
+      responseEnd(PROTOCOL_STATUS_BAD_FRAME);
+      return;
+    }
+    SettingsDataType type = (SettingsDataType)payload[pos];
+    size_t keyLen = payload[pos + 1];
+    pos += RECORD_HEADER_SIZE;
+    if (pos + keyLen + 1 > len) {
+      responseEnd(PROTOCOL_STATUS_BAD_FRAME);
+      return;
+    }
+    const uint8_t *keyBytes = &payload[pos];
+    pos += keyLen;
+    size_t valueLen = payload[pos++];
+    if (pos + valueLen > len) {
+      responseEnd(PROTOCOL_STATUS_BAD_FRAME);
+      return;
+    }
+    const uint8_t *valueBytes = &payload[pos];
+    pos += valueLen;
+
+    char key[SETTINGS_MAX_KEY_LENGTH] = {0};
+    char value[SETTINGS_MAX_VALUE_LENGTH] = {0};
+    if (keyLen == 0 || keyLen >= SETTINGS_MAX_KEY_LENGTH ||
+        valueLen >= SETTINGS_MAX_VALUE_LENGTH) {
+      failed++;
+      continue;
+    }
+    memcpy(key, keyBytes, keyLen);
+    memcpy(value, valueBytes, valueLen);
+    if (putRecord(type, key, value) == 0) {
+      applied++;
+    } else {
+      failed++;
+    }
+  }
+  uint8_t counts[2 * sizeof(uint16_t)];
+  writeLe(&counts[0], applied, sizeof(uint16_t));
+  writeLe(&counts[sizeof(uint16_t)], failed, sizeof(uint16_t));
+  responseAppend(counts, sizeof(counts));
+  responseEnd(failed == 0 ? PROTOCOL_STATUS_OK : PROTOCOL_STATUS_ERROR);
+}
+
+static void opSave() {
+  responseEnd(settings_save() == 0 ? PROTOCOL_STATUS_OK
+                                   : PROTOCOL_STATUS_ERROR);
+}
+
+static void opExport(const uint8_t *payload, size_t len) {
+  if (len != 1 || (payload[0] != SETTINGS_FORMAT_JSON &&
+                   payload[0] != SETTINGS_FORMAT_CBOR)) {
+    responseEnd(PROTOCOL_STATUS_BAD_FRAME);
+    return;
+  }
+  int err =
+      settings_export((SettingsStreamFormat)payload[0], exportSink, NULL);
+  responseEnd(err == 0 ? PROTOCOL_STATUS_OK : PROTOCOL_STATUS_ERROR);
+}
+
+// Fields of SettingsStats, in order
+static void opStats() {
+  SettingsStats stats;
+  settings_get_stats(&stats);
+  uint8_t data[3 * sizeof(uint16_t) + 5 * sizeof(uint32_t)];
+  uint8_t *pos = data;
+  writeLe(pos, stats.entries, sizeof(uint16_t));
+  pos += sizeof(uint16_t);
+  writeLe(pos, stats.maxEntries, sizeof(uint16_t));
+  pos += sizeof(uint16_t);
+  writeLe(pos, stats.persistedEntries, sizeof(uint16_t));
+  pos += sizeof(uint16_t);
+  writeLe(pos, stats.flashOffset, sizeof(uint32_t));
+  pos += sizeof(uint32_t);
+  writeLe(pos, stats.flashSize, sizeof(uint32_t));
+  pos += sizeof(uint32_t);
+  writeLe(pos, stats.generation, sizeof(uint32_t));
+  pos += sizeof(uint32_t);
+  writeLe(pos, stats.lastSaveUs, sizeof(uint32_t));
+  pos += sizeof(uint32_t);
+  writeLe(pos, stats.lastSaveIrqOffUs, sizeof(uint32_t));
+  responseAppend(data, sizeof(data));
+  responseEnd(PROTOCOL_STATUS_OK);
+}
+
+static void executeFrame(uint8_t opcode, const uint8_t *payload, size_t len) {
+  txOpcode = opcode;
+  txLength = 0;
+  switch (opcode) {
+    case PROTOCOL_OP_PING:
+      opPing();
+      break;
+    case PROTOCOL_OP_GET:
+      opGet(payload, len);
+      break;
+    case PROTOCOL_OP_PUT:
+      opPut(payload, len);
+      break;
+    case PROTOCOL_OP_SAVE:
+      opSave();
+      break;
+    case PROTOCOL_OP_EXPORT:
+      opExport(payload, len);
+      break;
+    case PROTOCOL_OP_STATS:
+      opStats();
+      break;
+    default:
+      responseEnd(PROTOCOL_STATUS_UNKNOWN_OP);
+      break;
+  }
+}
+
+bool protocolBusy() { return rxState != RX_IDLE; }
+
+void protocolFeed(uint8_t byte) {
+  rxLastByteUs = time_us_64();
+  switch (rxState) {
+    case RX_IDLE:
+      if (byte == PROTOCOL_SOF) {
+        rxState = RX_HEADER;
+        rxPos = 0;
+      }
+      break;
+    case RX_HEADER:
+      rxHeader[rxPos++] = byte;
+      if (rxPos == FRAME_HEADER_SIZE) {
+        rxLength = readLe(rxHeader, FRAME_LENGTH_SIZE);
+        rxPos = 0;
+        if (rxLength > PROTOCOL_MAX_PAYLOAD) {
+          // Cannot be received: answer now and swallow the payload and the
+          // CRC, so they never reach the command line
+          txOpcode = rxHeader[FRAME_LENGTH_SIZE];
+          responseEnd(PROTOCOL_STATUS_BAD_FRAME);
+          rxState = RX_DISCARD;
+        } else {
+          rxState = rxLength > 0 ? RX_PAYLOAD : RX_CRC;
+        }
+      }
+      break;
+    case RX_PAYLOAD:
+      rxPayload[rxPos++] = byte;
+      if (rxPos == rxLength) {
+        rxPos = 0;
+        rxState = RX_CRC;
+      }
+      break;
+    case RX_CRC:
+      rxCrc[rxPos++] = byte;
+      if (rxPos == FRAME_CRC_SIZE) {
+        rxState = RX_IDLE;
+        uint32_t crc = settings_crc32(0, rxHeader, FRAME_HEADER_SIZE);
+        crc = settings_crc32(crc, rxPayload, rxLength);
+        if (crc != readLe(rxCrc, FRAME_CRC_SIZE)) {
+          txOpcode = rxHeader[FRAME_LENGTH_SIZE];
+          txLength = 0;
+          responseEnd(PROTOCOL_STATUS_BAD_FRAME);
+        } else {
+          executeFrame(rxHeader[FRAME_LENGTH_SIZE], rxPayload, rxLength);
+        }
+      }
+      break;
+    case RX_DISCARD:
+      if (++rxPos == rxLength + FRAME_CRC_SIZE) {
+        rxState = RX_IDLE;
+      }
+      break;
+    default:
+      rxState = RX_IDLE;
+      break;
+  }
+}
+
+void protocolPoll() {
+  if (rxState != RX_IDLE && time_us_64() - rxLastByteUs > PROTOCOL_TIMEOUT_US) {
+    rxState = RX_IDLE;
+  }
+}
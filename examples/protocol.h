@@ -0,0 +1,87 @@
+/**
+ * File: protocol.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Framed binary protocol of the settings CLI, for host tools
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Every frame, in both directions, has the same layout. Multi-byte fields are
+ * little endian:
+ *
+ * - 1 byte: PROTOCOL_SOF
+ * - 2 bytes: length of the payload
+ * - 1 byte: opcode. Responses set PROTOCOL_RESPONSE_FLAG
+ * - N bytes: payload. Responses start with a status byte
+ * - 4 bytes: CRC32 of the length, the opcode and the payload
+ *
+ * PROTOCOL_SOF is not a printable character, so binary frames and text
+ * commands can be mixed on the same link: a frame can start whenever the text
+ * command line is empty.
+ *
+ * A frame longer than PROTOCOL_MAX_PAYLOAD is answered with
+ * PROTOCOL_STATUS_BAD_FRAME as soon as its header arrives, and the rest of it
+ * is discarded, up to its CRC or to PROTOCOL_TIMEOUT_US without bytes.
+ *
+ * Values travel as records, with the same layout as in the delta patches:
+ * type (1 byte), key length (1 byte), key, value length (1 byte), value. Values
+ * are text, as they are stored: booleans are "true" or "false".
+ */
+#define PROTOCOL_SOF 0x01
+#define PROTOCOL_VERSION 1
+#define PROTOCOL_RESPONSE_FLAG 0x80
+#define PROTOCOL_MAX_PAYLOAD 1024
+#define PROTOCOL_TIMEOUT_US 100000
+#define PROTOCOL_UNKNOWN_TYPE 0xFF
+
+// Opcodes
+enum {
+  PROTOCOL_OP_PING = 0x01,    // Response: protocol version
+  PROTOCOL_OP_GET = 0x02,     // Key length + key, repeated. Empty for all
+  PROTOCOL_OP_PUT = 0x03,     // Records. Response: applied and failed counts
+  PROTOCOL_OP_SAVE = 0x04,    // Response: status only
+  PROTOCOL_OP_EXPORT = 0x05,  // Format (SettingsStreamFormat)
+  PROTOCOL_OP_STATS = 0x06    // Response: SettingsStats fields
+};
+
+// Status of the responses
+enum {
+  PROTOCOL_STATUS_OK = 0x00,     // Last frame of the response
+  PROTOCOL_STATUS_MORE = 0x01,   // More frames of the response follow
+  PROTOCOL_STATUS_ERROR = 0x02,  // The request failed
+  PROTOCOL_STATUS_BAD_FRAME = 0x03,
+  PROTOCOL_STATUS_UNKNOWN_OP = 0x04
+};
+
+/**
+ * @brief Check if a frame is being received.
+ *
+ * @return true if bytes must be passed to protocolFeed().
+ */
+bool protocolBusy();
+
+/**
+ * @brief Process a byte of a frame.
+ *
+ * The first byte must be PROTOCOL_SOF. Complete frames are executed and
+ * answered right away.
+ *
+ * @param byte The byte received.
+ */
+void protocolFeed(uint8_t byte);
+
+/**
+ * @brief Drop a frame that stopped arriving for PROTOCOL_TIMEOUT_US.
+ *
+ * Call it periodically from the main loop.
+ */
+void protocolPoll();
+
+#endif  // PROTOCOL_H
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# Submodules of the stores compared by tools/bench, and their tags
+SUBMODULE_URLS=("git@github.com:littlefs-project/littlefs.git"
+                "git@github.com:armink/FlashDB.git")
+SUBMODULE_PATHS=("tools/bench/littlefs" "tools/bench/FlashDB")
+SUBMODULE_TAGS=("v2.9.3" "2.1.1")
+
+for i in "${!SUBMODULE_PATHS[@]}"; do
+    SUBMODULE_URL="${SUBMODULE_URLS[$i]}"
+    SUBMODULE_PATH="${SUBMODULE_PATHS[$i]}"
+    SUBMODULE_TAG="${SUBMODULE_TAGS[$i]}"
+
+    # Check if submodule already exists
+    if [ -e "$SUBMODULE_PATH/.git" ]; then
+        echo "Submodule $SUBMODULE_PATH already exists. Checking out tag $SUBMODULE_TAG..."
+    else
+        echo "Submodule $SUBMODULE_PATH does not exist. Adding..."
+        git submodule add --force "$SUBMODULE_URL" "$SUBMODULE_PATH"
+        git submodule update --init "$SUBMODULE_PATH"
+    fi
+    # Checkout the specific tag
+    (cd "$SUBMODULE_PATH" && git fetch --tags && git checkout "tags/$SUBMODULE_TAG")
+    git add "$SUBMODULE_PATH"
+done
+
+# Automatically commit the submodule updates
+git add .gitmodules
+git commit -m "Pin the benchmark stores to littlefs ${SUBMODULE_TAGS[0]} and FlashDB ${SUBMODULE_TAGS[1]}"
+
+echo "Benchmark stores pinned and committed."
@@ -1,5 +1,7 @@
 #include "settings.h"
 
+#include "settings_flash.h"
+
 // Static variables for storing the configuration data and flash memory settings
 // Global structure for holding settings
 static ConfigData configData;
@@ -7,6 +9,178 @@ static ConfigData configData;
 static uint32_t flashSettingsSize = SETTINGS_DEFAULT_FLASH_SIZE;
 // Offset in settings flash memory
 static uint32_t flashSettingsOffset = 0;
+// Default values, including the magic entry. Kept to restore default values.
+// The keys are the ones of the entries: the arena only packs the data type and
+// the text of each value, at the offset of the entry in defaultOffsets
+static uint32_t *defaultOffsets = NULL;
+static uint8_t *defaultArena = NULL;
+static size_t configDefaultsCount = 0;
+// Number of times the settings have been saved to flash
+static uint32_t settingsGeneration = 0;
+// CRC of each flash sector of the settings, as last loaded or saved
+static uint32_t *sectorCrcs = NULL;
+// Flash record each entry was loaded from, or SETTINGS_NO_RECORD
+static uint16_t *entryRecords = NULL;
+// CRC of the record of each entry, as last loaded or saved. Finds the entries
+// changed through the pointers of settings_find_entry() and the iterators
+static uint32_t *entryCrcs = NULL;
+// Number of records of the image in flash, as last loaded or saved
+static uint16_t imageRecords = 0;
+// Indexes of the entries sorted by key, for binary search and prefix queries
+static uint16_t *sortedEntries = NULL;
+// Entries changed since they were last loaded or saved
+static bool *entryDirty = NULL;
+// Persistence policy of each entry, plus the SETTINGS_ENTRY_LOCKED flag
+static uint8_t *entryPolicies = NULL;
+// Table of policies given by the user, applied on every init
+static const SettingsKeyPolicy *keyPolicies = NULL;
+static size_t keyPoliciesCount = 0;
+// Duration of the last save, and time with the interrupts disabled
+static uint32_t lastSaveUs = 0;
+static uint32_t lastSaveIrqOffUs = 0;
+// Callback invoked when the value of an entry changes
+static SettingsChangeFn changeCallback = NULL;
+static void *changeCallbackCtx = NULL;
+
+// Record index of entries not loaded from flash
+enum { SETTINGS_NO_RECORD = 0xFFFF, SETTINGS_STALE_RECORD = 0xFFFE };
+
+// Write-once entry already stored in flash. Combined with the policy
+enum { SETTINGS_ENTRY_LOCKED = 0x80, SETTINGS_POLICY_MASK = 0x7F };
+
+// Defined with the rest of the policies code
+static void settingsApplyPolicies();
+static void settingsLockWriteOnce(size_t index);
+
+// Flash storage, the default one. Reads go through XIP, and the erase and
+// program operations are run by the flash scheduler, so they share the lockout
+// windows with the rest of the writers of the flash
+static SettingsFlashOp flashStorageEraseOp;
+// Page being programmed, copied as the data is only valid during the write.
+// A stepwise save leaves its operation queued for the next steps
+static uint8_t flashStoragePage[FLASH_PAGE_SIZE];
+static SettingsFlashOp flashStoragePageOp;
+static bool flashStorageStepwise = false;
+
+// Queue an operation of the settings on the flash
+static int flashStorageSubmit(SettingsFlashOp *op, SettingsFlashOpType type,
+                              uint32_t offset, const void *data,
+                              size_t count) {
+  memset(op, 0, sizeof(SettingsFlashOp));
+  op->type = type;
+  op->offset = flashSettingsOffset + offset;
+  op->count = count;
+  op->data = (const uint8_t *)data;
+  op->priority = SETTINGS_FLASH_PRIORITY_SETTINGS;
+  return settings_flash_submit(op);
+}
+
+// Run an operation of the settings on the flash and wait for it
+static int flashStorageRun(SettingsFlashOp *op, SettingsFlashOpType type,
+                           uint32_t offset, const void *data, size_t count) {
+  if (flashStorageSubmit(op, type, offset, data, count) != 0) {
+    return -1;
+  }
+  return settings_flash_wait(op);
+}
+
+static int flashStorageRead(uint32_t offset, void *buffer, size_t len,
+                            void *ctx) {
+  memcpy(buffer, (const uint8_t *)(flashSettingsOffset + XIP_BASE) + offset,
+         len);
+  return 0;
+}
+
+static const uint8_t *flashStorageMap(void *ctx) {
+  return (const uint8_t *)(flashSettingsOffset + XIP_BASE);
+}
+
+static int flashStorageBegin(void *ctx) {
+  // Erase the content before writing the configuration
+  // overwriting it's not enough. Queued, so it runs in the same window as the
+  // first page
+  return flashStorageSubmit(&flashStorageEraseOp, SETTINGS_FLASH_ERASE, 0,
+                            NULL, flashSettingsSize);  // 4 Kbytes multiple
+}
+
+static int flashStorageWrite(uint32_t offset, const void *data, size_t len,
+                             void *ctx) {
+  if (len > FLASH_PAGE_SIZE) {
+    return -1;
+  }
+  memcpy(flashStoragePage, data, len);
+  if (flashStorageStepwise) {
+    return flashStorageSubmit(&flashStoragePageOp, SETTINGS_FLASH_PROGRAM,
+                              offset, flashStoragePage, len);
+  }
+  return flashStorageRun(&flashStoragePageOp, SETTINGS_FLASH_PROGRAM, offset,
+                         flashStoragePage, len);
+}
+
+static int flashStorageEnd(bool commit, void *ctx) {
+  // The region is erased even if nothing was written
+  return settings_flash_wait(&flashStorageEraseOp);
+}
+
+static int flashStorageErase(void *ctx) {
+  SettingsFlashOp op;
+  return flashStorageRun(&op, SETTINGS_FLASH_ERASE, 0, NULL,
+                         flashSettingsSize);  // 4 Kbytes
+}
+
+static int flashStorageInvalidate(void *ctx) {
+  // Programming can only clear bits, so a page of 0xFF leaves the flash as it
+  // is except for the bytes set to zero: the first character of the magic key
+  // and of its value. The image then reads as empty and with a wrong magic.
+  uint8_t page[FLASH_PAGE_SIZE];
+  memset(page, 0xFF, sizeof(page));
+  page[0] = 0;
+  page[offsetof(SettingsConfigEntry, value)] = 0;
+
+  SettingsFlashOp op;
+  return flashStorageRun(&op, SETTINGS_FLASH_PROGRAM, 0, page,
+                         FLASH_PAGE_SIZE);
+}
+
+static const SettingsStorageOps flashStorageOps = {
+    .read = flashStorageRead,
+    .map = flashStorageMap,
+    .begin = flashStorageBegin,
+    .write = flashStorageWrite,
+    .end = flashStorageEnd,
+    .erase = flashStorageErase,
+    .invalidate = flashStorageInvalidate};
+
+// Storage of the image, selected with settings_set_storage()
+static const SettingsStorageOps *storageOps = &flashStorageOps;
+static void *storageCtx = NULL;
+
+static int storageRead(uint32_t offset, void *buffer, size_t len) {
+  return storageOps->read(offset, buffer, len, storageCtx);
+}
+
+void settings_set_storage(const SettingsStorageOps *ops, void *ctx) {
+  storageOps = ops != NULL ? ops : &flashStorageOps;
+  storageCtx = ops != NULL ? ctx : NULL;
+}
+
+static SettingsPersistPolicy entryPolicy(size_t index) {
+  return (SettingsPersistPolicy)(entryPolicies[index] & SETTINGS_POLICY_MASK);
+}
+
+static bool isMagicEntry(const SettingsConfigEntry *entry) {
+  return strncmp(entry->key, SETTINGS_MAGICVERSION_KEY,
+                 SETTINGS_MAX_KEY_LENGTH) == 0;
+}
+
+// Keep the dirty state of an entry that changed and tell the application
+static void settingsNotifyChange(const SettingsConfigEntry *entry,
+                                 bool dirty) {
+  entryDirty[entry - configData.entries] = dirty;
+  if (changeCallback != NULL) {
+    changeCallback(entry, changeCallbackCtx);
+  }
+}
 
 // We should verify the key format always
 static int checkKeyFormat(const char key[SETTINGS_MAX_KEY_LENGTH]) {
@@ -63,9 +237,7 @@ static void settingsLoadDefaultEntries(const SettingsConfigEntry *entries,
             "characters long.\n",
             SETTINGS_MAX_KEY_LENGTH, entries[i].key, strlen(entries[i].key));
       }
-      SettingsConfigEntry tmpEntry = entries[i];
-      configData.entries[i] = tmpEntry;
-      configData.count++;
+      configData.entries[configData.count++] = entries[i];
     }
   }
 
@@ -79,27 +251,17 @@ static void settingsLoadDefaultEntries(const SettingsConfigEntry *entries,
   }
 }
 
-// Load all entries from the FLASH memory, if any. Otherwise, use the default
-// entries.
-static int settingsLoadAllEntries(const SettingsConfigEntry *entries,
-                                   uint16_t numEntries, uint16_t maxEntries) {
-  uint8_t *currentAddress = (uint8_t *)(flashSettingsOffset + XIP_BASE);
-
-  // First, load default entries
-  settingsLoadDefaultEntries(entries, numEntries);
-
+// Read the magic value of the settings stored in FLASH and check it belongs
+// to this configuration. Also returns the generation stored with it.
+static bool settingsReadFlashMagic(uint32_t *generationOut) {
   // Read the magic value from the FLASH memory
   // it must be always the first value in the memory setting
-  const uint8_t *magicAddress =
-      (const uint8_t *)(currentAddress + SETTINGS_MAX_KEY_LENGTH +
-                        sizeof(SettingsDataType));
   // Now it's safe to read the magic value until \0 o SETTINGS_MAX_VALUE_LENGTH
   char magicChar[SETTINGS_MAX_VALUE_LENGTH] = {0};
-  for (size_t i = 0; i < SETTINGS_MAX_VALUE_LENGTH; i++) {
-    if (magicAddress[i] == '\0') {
-      break;
-    }
-    magicChar[i] = magicAddress[i];
+  if (storageRead(offsetof(SettingsConfigEntry, value), magicChar,
+                  SETTINGS_MAX_VALUE_LENGTH - 1) != 0) {
+    DPRINTF("Cannot read the settings. Using default values.\n");
+    return false;
   }
   uint32_t magic = (uint32_t)strtoul(magicChar, NULL, SETTINGS_BASE_10);
 
@@ -107,37 +269,217 @@ static int settingsLoadAllEntries(const SettingsConfigEntry *entries,
     // No config found in FLASH. Use default values
     DPRINTF("%lu!=%lu. No config found in FLASH. Using default values.\n",
             magic, configData.magic);
-    return -1;
+    return false;
   }
   DPRINTF("Magic value found in FLASH: %lu. Loading the existing values.\n",
           magic);
 
-  uint16_t count = 0;
-  while (count < numEntries) {
-    SettingsConfigEntry entry = {0};
-    memcpy(&entry, currentAddress, sizeof(SettingsConfigEntry));
+  // The generation follows the magic value, separated by a colon. Images
+  // saved by older versions have no generation and start at zero.
+  const char *generation = strchr(magicChar, SETTINGS_GENERATION_SEPARATOR);
+  *generationOut =
+      generation ? (uint32_t)strtoul(generation + 1, NULL, SETTINGS_BASE_10)
+                 : 0;
+  DPRINTF("Generation found in FLASH: %lu\n", *generationOut);
+  return true;
+}
 
-    currentAddress += sizeof(SettingsConfigEntry);
+// Read the record at the given index of the settings stored in FLASH. Returns
+// false at the end of the entries.
+static bool settingsReadFlashRecord(uint16_t index,
+                                    SettingsConfigEntry *entry) {
+  if ((size_t)(index + 1) * sizeof(SettingsConfigEntry) > flashSettingsSize ||
+      storageRead(index * sizeof(SettingsConfigEntry), entry,
+                  sizeof(SettingsConfigEntry)) != 0) {
+    return false;
+  }
 
-    // Check for the end of the config entries
-    if (entry.key[0] == '\0') {
-      break;  // Exit the loop if we encounter a key length of 0 (end of
-              // entries)
+  // Check for the end of the config entries
+  if (entry->key[0] == '\0') {
+    return false;  // A key length of 0 is the end of entries
+  }
+
+  if (memchr(entry->key, '\0', SETTINGS_MAX_KEY_LENGTH) == NULL ||
+      checkKeyFormat(entry->key) != 0) {
+    DPRINTF(
+        "Invalid key format for key at record %u. Likely end of entries "
+        "in FLASH.\n",
+        index);
+    return false;
+  }
+
+  if (checkTypeFormat(entry->dataType) != 0) {
+    DPRINTF(
+        "Invalid type format for key %s stored. Likely end of entries in "
+        "FLASH.\n",
+        entry->key);
+    return false;
+  }
+  return true;
+}
+
+// Bytes of the image covered by the CRCs of the sectors. Storages written in
+// place keep the old records past the end of the image, so only the records
+// up to the one ending the image count: nobody reads past it, and a longer
+// image overwrites it. A save in place knows all of them without reading
+static uint32_t settingsCrcExtent() {
+  if (!storageOps->inPlace) {
+    return flashSettingsSize;
+  }
+  size_t maxRecords = flashSettingsSize / sizeof(SettingsConfigEntry);
+  size_t records = (size_t)imageRecords + 1;
+  return (records < maxRecords ? records : maxRecords) *
+         sizeof(SettingsConfigEntry);
+}
+
+// CRC of a FLASH sector of the settings. Storages not mapped in memory are
+// read in small chunks
+static uint32_t settingsSectorCrc(size_t sector) {
+  uint32_t offset = sector * SETTINGS_FLASH_PAGE_SIZE;
+  uint32_t end = offset + SETTINGS_FLASH_PAGE_SIZE;
+  uint32_t extent = settingsCrcExtent();
+  size_t len = extent <= offset ? 0 : (extent < end ? extent : end) - offset;
+  if (storageOps->map != NULL) {
+    return settings_crc32(0, storageOps->map(storageCtx) + offset, len);
+  }
+  uint8_t chunk[SETTINGS_STREAM_CHUNK_SIZE];
+  uint32_t crc = 0;
+  for (size_t done = 0; done < len; done += sizeof(chunk)) {
+    size_t chunkLen = len - done < sizeof(chunk) ? len - done : sizeof(chunk);
+    if (storageRead(offset + done, chunk, chunkLen) != 0) {
+      memset(chunk, 0, sizeof(chunk));
     }
+    crc = settings_crc32(crc, chunk, chunkLen);
+  }
+  return crc;
+}
 
-    if (checkKeyFormat(entry.key) != 0) {
-      DPRINTF(
-          "Invalid key format for key at address %p. Likely end of entries "
-          "in FLASH.\n",
-          currentAddress);
-      break;
+// Compute the CRC of every FLASH sector of the settings, to detect later
+// which ones have been changed by someone else
+static void settingsUpdateSectorCrcs() {
+  size_t numSectors = flashSettingsSize / SETTINGS_FLASH_PAGE_SIZE;
+  for (size_t i = 0; i < numSectors; i++) {
+    sectorCrcs[i] = settingsSectorCrc(i);
+  }
+}
+
+static int compareSortedEntries(const void *a, const void *b) {
+  uint16_t left = *(const uint16_t *)a;
+  uint16_t right = *(const uint16_t *)b;
+  int cmp = strncmp(configData.entries[left].key, configData.entries[right].key,
+                    SETTINGS_MAX_KEY_LENGTH);
+  // Duplicated keys keep their order, so the first one is found
+  return cmp != 0 ? cmp : (int)left - (int)right;
+}
+
+// Sort the entries by key. The keys do not change after the defaults are
+// loaded, so the index is built once per init
+static void settingsBuildIndex() {
+  for (size_t i = 0; i < configData.count; i++) {
+    sortedEntries[i] = (uint16_t)i;
+  }
+  qsort(sortedEntries, configData.count, sizeof(uint16_t),
+        compareSortedEntries);
+}
+
+// Position in the index of the first key not lower than the given one. With
+// a length smaller than SETTINGS_MAX_KEY_LENGTH, only that many characters
+// are compared, and upper selects the first key greater instead of equal
+static size_t settingsIndexBound(const char *key, size_t len, bool upper) {
+  size_t low = 0;
+  size_t high = configData.count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    int cmp = strncmp(configData.entries[sortedEntries[mid]].key, key, len);
+    if (cmp < 0 || (upper && cmp == 0)) {
+      low = mid + 1;
+    } else {
+      high = mid;
     }
+  }
+  return low;
+}
 
-    if (checkTypeFormat(entry.dataType) != 0) {
-      DPRINTF(
-          "Invalid type format for key %s stored. Likely end of entries in "
-          "FLASH.\n",
-          entry.key);
+// Index of the entry with the given key, or -1
+static int settingsFindIndex(const char *key) {
+  if (sortedEntries == NULL) {
+    return -1;
+  }
+  size_t pos = settingsIndexBound(key, SETTINGS_MAX_KEY_LENGTH, false);
+  if (pos < configData.count &&
+      strncmp(configData.entries[sortedEntries[pos]].key, key,
+              SETTINGS_MAX_KEY_LENGTH) == 0) {
+    return sortedEntries[pos];
+  }
+  return -1;
+}
+
+// Unpack the default value of a key. False if the key is unknown
+static bool findDefaultEntry(const char *key, SettingsConfigEntry *out) {
+  int index = settingsFindIndex(key);
+  if (index < 0 || defaultOffsets == NULL) {
+    return false;
+  }
+  const uint8_t *packed = &defaultArena[defaultOffsets[index]];
+  memset(out, 0, sizeof(SettingsConfigEntry));
+  memcpy(out->key, configData.entries[index].key, SETTINGS_MAX_KEY_LENGTH);
+  out->dataType = (SettingsDataType)packed[0];
+  strncpy(out->value, (const char *)&packed[1], SETTINGS_MAX_VALUE_LENGTH - 1);
+  return true;
+}
+
+static bool entryValueEquals(const SettingsConfigEntry *left,
+                             const SettingsConfigEntry *right) {
+  return left->dataType == right->dataType &&
+         strncmp(left->value, right->value, SETTINGS_MAX_VALUE_LENGTH) == 0;
+}
+
+// Pack the default values of the entries, before any is loaded from flash
+static void settingsPackDefaults() {
+  size_t arenaSize = 0;
+  for (size_t i = 0; i < configData.count; i++) {
+    arenaSize +=
+        strnlen(configData.entries[i].value, SETTINGS_MAX_VALUE_LENGTH - 1) + 2;
+  }
+  free(defaultOffsets);
+  free(defaultArena);
+  defaultOffsets = (uint32_t *)malloc(configData.count * sizeof(uint32_t));
+  defaultArena = (uint8_t *)malloc(arenaSize);
+  uint32_t offset = 0;
+  for (size_t i = 0; i < configData.count; i++) {
+    const SettingsConfigEntry *entry = &configData.entries[i];
+    size_t len = strnlen(entry->value, SETTINGS_MAX_VALUE_LENGTH - 1);
+    defaultOffsets[i] = offset;
+    defaultArena[offset] = (uint8_t)entry->dataType;
+    memcpy(&defaultArena[offset + 1], entry->value, len);
+    defaultArena[offset + 1 + len] = '\0';
+    offset += len + 2;
+  }
+  DPRINTF("Packed %d default values in %lu bytes.\n", configData.count,
+          arenaSize);
+}
+
+// Load all entries from the FLASH memory, if any. Otherwise, use the default
+// entries.
+static int settingsLoadAllEntries(const SettingsConfigEntry *entries,
+                                   uint16_t numEntries) {
+  // First, load default entries
+  settingsLoadDefaultEntries(entries, numEntries);
+  settingsPackDefaults();
+  settingsBuildIndex();
+  for (size_t i = 0; i < configData.count; i++) {
+    entryRecords[i] = SETTINGS_NO_RECORD;
+  }
+  imageRecords = 0;
+
+  if (!settingsReadFlashMagic(&settingsGeneration)) {
+    return -1;
+  }
+
+  uint16_t count = 0;
+  while (count < numEntries) {
+    SettingsConfigEntry entry = {0};
+    if (!settingsReadFlashRecord(count, &entry)) {
       break;
     }
 
@@ -147,10 +489,14 @@ static int settingsLoadAllEntries(const SettingsConfigEntry *entries,
     SettingsConfigEntry *existingEntry = settings_find_entry(keyStr);
     if (existingEntry) {
       *existingEntry = entry;
+      entryRecords[existingEntry - configData.entries] = count;
+      entryCrcs[existingEntry - configData.entries] =
+          settings_crc32(0, &entry, sizeof(entry));
     }
     // No else part here since we know every memory entry has a default
     count++;
   }
+  imageRecords = count;
   return 0;
 }
 
@@ -177,11 +523,28 @@ int settings_init(const SettingsConfigEntry *defaultEntries,
   assert(defaultNumEntries <= maxEntries);
   DPRINTF("Default entries count: %d\n", defaultNumEntries);
 
-  // Initialize the number of entries to the default entries count
-  uint32_t entriesMemorySize = flashSettingsSize;
-  configData.entries = (SettingsConfigEntry *)malloc(entriesMemorySize);
-  DPRINTF("Reserved memory %lu for %d entries.\n", entriesMemorySize,
-          maxEntries);
+  // Only the default entries and the magic entry are kept in memory. The end
+  // of the image is marked when it is written
+  size_t numEntries = defaultNumEntries + 1;
+  free(configData.entries);
+  configData.count = 0;
+  configData.entries =
+      (SettingsConfigEntry *)calloc(numEntries, sizeof(SettingsConfigEntry));
+  free(entryRecords);
+  entryRecords = (uint16_t *)malloc(numEntries * sizeof(uint16_t));
+  free(entryPolicies);
+  entryPolicies = (uint8_t *)calloc(numEntries, sizeof(uint8_t));
+  free(sectorCrcs);
+  sectorCrcs = (uint32_t *)malloc(flashSettingsSize /
+                                  SETTINGS_FLASH_PAGE_SIZE * sizeof(uint32_t));
+  free(sortedEntries);
+  sortedEntries = (uint16_t *)malloc(numEntries * sizeof(uint16_t));
+  free(entryDirty);
+  entryDirty = (bool *)calloc(numEntries, sizeof(bool));
+  free(entryCrcs);
+  entryCrcs = (uint32_t *)calloc(numEntries, sizeof(uint32_t));
+  DPRINTF("Reserved memory %lu for %d entries.\n",
+          numEntries * sizeof(SettingsConfigEntry), numEntries);
 
   // Create the large magic value by combining the magic and version
   configData.magic = (magic << SETTINGS_SHIFT_LEFT_16_BITS) | version;
@@ -204,9 +567,18 @@ int settings_init(const SettingsConfigEntry *defaultEntries,
   memcpy(defaultEntriesWithMagic + 1, defaultEntries,
          defaultNumEntries * sizeof(SettingsConfigEntry));
 
+  configDefaultsCount = defaultNumEntries + 1;
+  settingsGeneration = 0;
+  lastSaveUs = 0;
+  lastSaveIrqOffUs = 0;
+
   // Load the configuration from FLASH
-  int error = settingsLoadAllEntries(defaultEntriesWithMagic, defaultNumEntries + 1,
-                         maxEntries);
+  int error =
+      settingsLoadAllEntries(defaultEntriesWithMagic, defaultNumEntries + 1);
+  // The default values are packed, the clone is not needed anymore
+  free(defaultEntriesWithMagic);
+  settingsUpdateSectorCrcs();
+  settingsApplyPolicies();
 
   // Return the number of entries loaded into memory
   return (error == 0 ? configData.count : error);
@@ -225,15 +597,64 @@ SettingsConfigEntry *settings_find_entry(
     DPRINTF("Invalid key format for key %s.\n", key);
     return NULL;
   }
-  for (size_t i = 0; i < configData.count; i++) {
-    if (strncmp(configData.entries[i].key, key, SETTINGS_MAX_KEY_LENGTH) == 0) {
-      return &configData.entries[i];
-    }
+  int index = settingsFindIndex(key);
+  if (index >= 0) {
+    return &configData.entries[index];
   }
   DPRINTF("Key %s not found.\n", key);
   return NULL;
 }
 
+size_t settings_iter_begin(SettingsIterator *iter, const char *prefix) {
+  size_t len = prefix != NULL ? strlen(prefix) : 0;
+  len = len < SETTINGS_MAX_KEY_LENGTH ? len : SETTINGS_MAX_KEY_LENGTH;
+  iter->filter = SETTINGS_FILTER_NONE;
+  if (sortedEntries == NULL) {
+    iter->next = 0;
+    iter->end = 0;
+    return 0;
+  }
+  if (len == 0) {
+    iter->next = 0;
+    iter->end = configData.count;
+  } else {
+    iter->next = settingsIndexBound(prefix, len, false);
+    iter->end = settingsIndexBound(prefix, len, true);
+  }
+  size_t count = iter->end - iter->next;
+  // The magic entry is never returned
+  if (count > 0 &&
+      (len == 0 || strncmp(SETTINGS_MAGICVERSION_KEY, prefix, len) == 0)) {
+    count--;
+  }
+  return count;
+}
+
+// Check an entry against the filter of an iterator
+static bool settingsIterMatch(const SettingsIterator *iter, size_t index) {
+  const SettingsConfigEntry *entry = &configData.entries[index];
+  uint8_t types = iter->filter & ~SETTINGS_FILTER_DIRTY;
+  if (isMagicEntry(entry) ||
+      ((iter->filter & SETTINGS_FILTER_DIRTY) && !entryDirty[index])) {
+    return false;
+  }
+  return types == 0 || (types & (1 << entry->dataType)) != 0;
+}
+
+SettingsConfigEntry *settings_iter_next(SettingsIterator *iter) {
+  while (iter->next < iter->end) {
+    size_t index = sortedEntries[iter->next++];
+    if (settingsIterMatch(iter, index)) {
+      return &configData.entries[index];
+    }
+  }
+  return NULL;
+}
+
+void settings_iter_filter(SettingsIterator *iter, uint8_t filter) {
+  iter->filter = filter;
+}
+
 static int settingsUpdateEntry(const char key[SETTINGS_MAX_KEY_LENGTH],
                                SettingsDataType dataType,
                                char value[SETTINGS_MAX_VALUE_LENGTH]) {
@@ -243,19 +664,27 @@ static int settingsUpdateEntry(const char key[SETTINGS_MAX_KEY_LENGTH],
     return -1;
   }
   // Check if the key already exists
-  for (size_t i = 0; i < configData.count; i++) {
-    if (strncmp(configData.entries[i].key, key, SETTINGS_MAX_KEY_LENGTH) == 0) {
-      // Key already exists. Update its value and dataType
-      configData.entries[i].dataType = dataType;
-      strncpy(configData.entries[i].value, value,
-              SETTINGS_MAX_VALUE_LENGTH - 1);
-      configData.entries[i].value[SETTINGS_MAX_VALUE_LENGTH - 1] =
-          '\0';  // Ensure null-termination
-      return 0;  // Successfully updated existing entry
-    }
+  int i = settingsFindIndex(key);
+  if (i < 0) {
+    DPRINTF("Key %s not found.\n", key);
+    return -1;  // Key not found. Cannot update non-existing entry
   }
-  DPRINTF("Key %s not found.\n", key);
-  return -1;  // Key not found. Cannot update non-existing entry
+  if (entryPolicies[i] & SETTINGS_ENTRY_LOCKED) {
+    DPRINTF("Key %s is write-once and already stored.\n", key);
+    return -1;
+  }
+  // Key already exists. Update its value and dataType
+  bool changed = configData.entries[i].dataType != dataType ||
+                 strncmp(configData.entries[i].value, value,
+                         SETTINGS_MAX_VALUE_LENGTH - 1) != 0;
+  configData.entries[i].dataType = dataType;
+  strncpy(configData.entries[i].value, value, SETTINGS_MAX_VALUE_LENGTH - 1);
+  configData.entries[i].value[SETTINGS_MAX_VALUE_LENGTH - 1] =
+      '\0';  // Ensure null-termination
+  if (changed) {
+    settingsNotifyChange(&configData.entries[i], true);
+  }
+  return 0;  // Successfully updated existing entry
 }
 
 int settings_put_bool(const char key[SETTINGS_MAX_KEY_LENGTH], bool value) {
@@ -278,46 +707,307 @@ int settings_put_integer(const char key[SETTINGS_MAX_KEY_LENGTH], int value) {
   return settingsUpdateEntry(key, SETTINGS_TYPE_INT, configValue);
 }
 
-int settings_save() {
-  uint8_t *address = (uint8_t *)(flashSettingsOffset + XIP_BASE);
+// Accumulates the image in pages and writes each one when it is full
+typedef struct {
+  uint8_t page[FLASH_PAGE_SIZE];
+  size_t fill;
+  uint32_t offset;
+  int error;  // First error of the storage. Later pages are not written
+} PageWriter;
+
+static void pageWriterFlush(PageWriter *writer) {
+  if (writer->fill == 0) {
+    return;
+  }
+  // Leave the rest of the page erased
+  memset(writer->page + writer->fill, 0xFF, FLASH_PAGE_SIZE - writer->fill);
+  if (writer->error == 0) {
+    writer->error = storageOps->write(writer->offset, writer->page,
+                                      FLASH_PAGE_SIZE, storageCtx);
+  }
+  writer->offset += FLASH_PAGE_SIZE;
+  writer->fill = 0;
+}
+
+static void pageWriterAppend(PageWriter *writer, const void *data,
+                             size_t len) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  while (len > 0) {
+    size_t chunk = FLASH_PAGE_SIZE - writer->fill;
+    chunk = len < chunk ? len : chunk;
+    memcpy(writer->page + writer->fill, bytes, chunk);
+    writer->fill += chunk;
+    bytes += chunk;
+    len -= chunk;
+    if (writer->fill == FLASH_PAGE_SIZE) {
+      pageWriterFlush(writer);
+    }
+  }
+}
+
+// Empty entry marking the end of the image
+static const SettingsConfigEntry endEntry = {0};
+
+// Whether a record written in place already holds an entry: the entry was
+// loaded from or saved to that record and its bytes have the same CRC, or the
+// end mark closes an image of the same length. The magic entry always
+// changes, with the generation
+static bool settingsRecordStored(uint16_t record,
+                                 const SettingsConfigEntry *entry) {
+  if (entry == &endEntry) {
+    return record == imageRecords;
+  }
+  size_t index = entry - configData.entries;
+  return record != 0 && !entryDirty[index] && entryRecords[index] == record &&
+         settings_crc32(0, entry, sizeof(SettingsConfigEntry)) ==
+             entryCrcs[index];
+}
+
+// Add the bytes of a record to the CRCs of the sectors it lies in. The
+// records must be added in order, from the first one
+static void settingsCrcAddRecord(uint16_t record,
+                                 const SettingsConfigEntry *entry) {
+  const uint8_t *bytes = (const uint8_t *)entry;
+  uint32_t offset = (uint32_t)record * sizeof(SettingsConfigEntry);
+  size_t len = sizeof(SettingsConfigEntry);
+  while (len > 0) {
+    size_t sector = offset / SETTINGS_FLASH_PAGE_SIZE;
+    size_t chunk = SETTINGS_FLASH_PAGE_SIZE - offset % SETTINGS_FLASH_PAGE_SIZE;
+    chunk = len < chunk ? len : chunk;
+    sectorCrcs[sector] = settings_crc32(sectorCrcs[sector], bytes, chunk);
+    offset += chunk;
+    bytes += chunk;
+    len -= chunk;
+  }
+}
+
+// Stages of a save
+typedef enum {
+  SAVE_IDLE = 0,
+  SAVE_ENTRIES,  // The persistent entries, in order
+  SAVE_END_MARK, // The empty entry marking the end, if it fits
+  SAVE_LAST,     // The last page, or the magic entry when written in place
+  SAVE_DONE
+} SaveStage;
+
+// State of the save in progress, written a piece at a time
+typedef struct {
+  SaveStage stage;
+  size_t next;       // Next entry to write
+  uint16_t records;  // Records written, including the magic entry
+  int error;         // First error of the storage
+  uint64_t startUs;
+  uint64_t irqOffUs;
+  uint32_t lockedUs;
+  PageWriter writer;
+} SaveState;
+
+static SaveState saveState = {0};
+
+// Write the next piece of the image and move to the next stage if needed.
+// Storages erased by begin() get whole pages: only the pages holding
+// persistent entries, followed by an empty entry marking the end. Storages
+// written in place only get the records they do not hold yet, one at a time,
+// without reading them back, and the magic entry goes last, so the generation
+// only changes once the rest of the image is written
+static void settingsSaveWriteNext() {
+  PageWriter *writer = &saveState.writer;
+  bool inPlace = storageOps->inPlace;
+  uint32_t pageOffset = writer->offset;
+  bool written = false;
+  while (!written && saveState.error == 0 && saveState.stage != SAVE_DONE) {
+    const SettingsConfigEntry *entry = NULL;
+    uint16_t record = saveState.records;
+    switch (saveState.stage) {
+      case SAVE_ENTRIES:
+        if (saveState.next == configData.count) {
+          saveState.stage = SAVE_END_MARK;
+        } else if (entryPolicy(saveState.next++) !=
+                   SETTINGS_POLICY_VOLATILE) {
+          entry = &configData.entries[saveState.next - 1];
+          saveState.records++;
+        }
+        break;
+      case SAVE_END_MARK:
+        saveState.stage = SAVE_LAST;
+        if ((size_t)(record + 1) * sizeof(SettingsConfigEntry) <=
+            flashSettingsSize) {
+          entry = &endEntry;
+        }
+        break;
+      default:
+        saveState.stage = SAVE_DONE;
+        if (inPlace) {
+          entry = &configData.entries[0];
+          record = 0;
+        } else {
+          pageWriterFlush(writer);
+        }
+        break;
+    }
+    if (entry != NULL && inPlace && !settingsRecordStored(record, entry)) {
+      saveState.error = storageOps->write(
+          (uint32_t)record * sizeof(SettingsConfigEntry), entry,
+          sizeof(SettingsConfigEntry), storageCtx);
+      written = true;
+    } else if (entry != NULL && !inPlace) {
+      pageWriterAppend(writer, entry, sizeof(SettingsConfigEntry));
+    }
+    if (!inPlace) {
+      saveState.error = writer->error;
+      written = writer->offset != pageOffset;
+    }
+  }
+}
 
-  // Ensure we don't exceed the reserved space
-  if (configData.count * sizeof(SettingsConfigEntry) > flashSettingsSize) {
-    return -1;  // Error: Config size exceeds reserved space
+// Start a save: stamp the new generation and open the storage. A stepwise
+// save only queues the flash operations, and the steps run them
+static int settingsSaveStart(bool stepwise) {
+  // Only one save at a time, and ensure we don't exceed the reserved space
+  if (saveState.stage != SAVE_IDLE ||
+      configData.count * sizeof(SettingsConfigEntry) > flashSettingsSize) {
+    return -1;  // Error: Saving, or config size exceeds reserved space
   }
+  memset(&saveState, 0, sizeof(SaveState));
+  saveState.startUs = time_us_64();
+
+  // Stamp the new generation in the magic entry, always the first one
+  settingsGeneration++;
+  snprintf(configData.entries[0].value, SETTINGS_MAX_VALUE_LENGTH, "%lu%c%lu",
+           configData.magic, SETTINGS_GENERATION_SEPARATOR, settingsGeneration);
+
   DPRINTF("Writing %d entries to FLASH.\n", configData.count);
   DPRINTF("Size of entries: %lu\n",
           configData.count * sizeof(SettingsConfigEntry));
 
-  uint32_t ints = save_and_disable_interrupts();
+  SettingsFlashStats flashStats;
+  settings_flash_get_stats(&flashStats);
+  saveState.lockedUs = flashStats.lockedUs;
+  saveState.irqOffUs = time_us_64();
+  flashStorageStepwise = stepwise;
+  if (storageOps->begin != NULL && storageOps->begin(storageCtx) != 0) {
+    DPRINTF("Cannot start writing the settings.\n");
+    settingsGeneration--;
+    flashStorageStepwise = false;
+    return -1;
+  }
+  // The magic entry is written last when in place
+  saveState.stage = SAVE_ENTRIES;
+  saveState.next = storageOps->inPlace ? 1 : 0;
+  saveState.records = storageOps->inPlace ? 1 : 0;
+  return 0;
+}
 
-  // Erase the content before writing the configuration
-  // overwriting it's not enough
-  flash_range_erase(flashSettingsOffset,
-                    flashSettingsSize);  // 4 Kbytes multiple
+// Close the storage and, if the image was written, update the state of the
+// entries
+static int settingsSaveFinish() {
+  int writeError = saveState.error;
+  saveState.stage = SAVE_IDLE;
+  flashStorageStepwise = false;
 
-  // Transfer config to FLASH
-  flash_range_program(flashSettingsOffset, (uint8_t *)configData.entries,
-                      flashSettingsSize);
+  int error = storageOps->end != NULL
+                  ? storageOps->end(writeError == 0, storageCtx)
+                  : 0;
+  lastSaveIrqOffUs = (uint32_t)(time_us_64() - saveState.irqOffUs);
+  if (storageOps == &flashStorageOps) {
+    // Only the lockout windows of the scheduler stop the interrupts
+    SettingsFlashStats flashStats;
+    settings_flash_get_stats(&flashStats);
+    lastSaveIrqOffUs = flashStats.lockedUs - saveState.lockedUs;
+  }
+  if (writeError != 0 || error != 0) {
+    // The records of the previous image are still valid, if it was kept.
+    // In place, some of them may be overwritten: write them all next time
+    DPRINTF("Cannot write the settings.\n");
+    settingsGeneration--;
+    for (size_t i = 0; storageOps->inPlace && i < configData.count; i++) {
+      if (entryRecords[i] != SETTINGS_NO_RECORD) {
+        entryRecords[i] = SETTINGS_STALE_RECORD;
+      }
+    }
+    return -1;
+  }
 
-  restore_interrupts(ints);
+  // In place, the CRCs of the sectors come from the records just stored
+  size_t numSectors = flashSettingsSize / SETTINGS_FLASH_PAGE_SIZE;
+  if (storageOps->inPlace) {
+    memset(sectorCrcs, 0, numSectors * sizeof(uint32_t));
+  }
+  uint16_t records = 0;
+  for (size_t i = 0; i < configData.count; i++) {
+    if (entryPolicy(i) == SETTINGS_POLICY_VOLATILE) {
+      entryRecords[i] = SETTINGS_NO_RECORD;
+      continue;
+    }
+    if (storageOps->inPlace) {
+      settingsCrcAddRecord(records, &configData.entries[i]);
+    }
+    entryRecords[i] = records++;
+    entryCrcs[i] =
+        settings_crc32(0, &configData.entries[i], sizeof(SettingsConfigEntry));
+    entryDirty[i] = false;
+    settingsLockWriteOnce(i);
+  }
+  imageRecords = records;
+  if (!storageOps->inPlace) {
+    settingsUpdateSectorCrcs();
+  } else if ((size_t)(records + 1) * sizeof(SettingsConfigEntry) <=
+             flashSettingsSize) {
+    settingsCrcAddRecord(records, &endEntry);
+  }
+  lastSaveUs = (uint32_t)(time_us_64() - saveState.startUs);
 
   return 0;  // Successful write
 }
 
-int settings_erase() {
-  uint32_t ints = save_and_disable_interrupts();
+int settings_save() {
+  if (settingsSaveStart(false) != 0) {
+    return -1;
+  }
+  // Transfer config to FLASH
+  while (saveState.stage != SAVE_DONE && saveState.error == 0) {
+    settingsSaveWriteNext();
+  }
+  return settingsSaveFinish();
+}
 
-  // Erase the content before writing the configuration
-  // overwriting it's not enough
-  flash_range_erase(flashSettingsOffset, flashSettingsSize);  // 4 Kbytes
+int settings_save_begin() { return settingsSaveStart(true); }
+
+int settings_save_step() {
+  if (saveState.stage == SAVE_IDLE) {
+    return -1;
+  }
+  if (flashStorageEraseOp.status == SETTINGS_FLASH_PENDING ||
+      flashStoragePageOp.status == SETTINGS_FLASH_PENDING) {
+    settings_flash_step();
+    return SETTINGS_SAVE_IN_PROGRESS;
+  }
+  if (saveState.stage != SAVE_DONE && saveState.error == 0) {
+    settingsSaveWriteNext();
+    return SETTINGS_SAVE_IN_PROGRESS;
+  }
+  return settingsSaveFinish();
+}
 
-  restore_interrupts(ints);
+int settings_erase() {
+  int error = storageOps->erase(storageCtx);
 
   free(configData.entries);
   memset(&configData, 0, sizeof(ConfigData));
+  free(entryRecords);
+  entryRecords = NULL;
+  free(entryPolicies);
+  entryPolicies = NULL;
+  free(sectorCrcs);
+  sectorCrcs = NULL;
+  free(sortedEntries);
+  sortedEntries = NULL;
+  free(entryDirty);
+  entryDirty = NULL;
+  free(entryCrcs);
+  entryCrcs = NULL;
 
-  return 0;  // Successful write
+  return error;
 }
 
 void settings_print() {
@@ -332,7 +1022,9 @@ void settings_print() {
   DPRINTF("+---+%.*s+%.*s+----------+\n", SETTINGS_MAX_KEY_LENGTH + 2, dashes,
           SETTINGS_MAX_VALUE_LENGTH + 2, dashes);
 
-  for (size_t i = 0; i < configData.count; i++) {
+  // Sorted by key
+  for (size_t pos = 0; pos < configData.count; pos++) {
+    size_t i = sortedEntries[pos];
     char valueStr[SETTINGS_MAX_VALUE_LENGTH];  // Buffer to format the value
 
     switch (configData.entries[i].dataType) {
@@ -371,3 +1063,1429 @@ void settings_print() {
   DPRINTF("+---+%.*s+%.*s+----------+\n", SETTINGS_MAX_KEY_LENGTH + 2, dashes,
           SETTINGS_MAX_VALUE_LENGTH + 2, dashes);
 }
+
+// Buffered writer used by the streaming exporter. It only holds one chunk, so
+// the memory used is constant regardless of the number of entries.
+typedef struct {
+  SettingsSinkFn sink;
+  void *ctx;
+  uint8_t buffer[SETTINGS_STREAM_CHUNK_SIZE];
+  size_t len;
+  int error;
+  bool withCrc;
+  uint32_t crc;
+} StreamWriter;
+
+enum {
+  CBOR_MAJOR_UINT = 0,
+  CBOR_MAJOR_NEGINT = 1,
+  CBOR_MAJOR_TEXT = 3,
+  CBOR_MAJOR_MAP = 5,
+  CBOR_MAJOR_SIMPLE = 7,
+  CBOR_MAJOR_SHIFT = 5,
+  CBOR_INFO_MASK = 0x1F,
+  CBOR_INFO_UINT8 = 24,
+  CBOR_INFO_UINT64 = 27,
+  CBOR_INFO_INDEFINITE = 31,
+  CBOR_SIMPLE_FALSE = 20,
+  CBOR_SIMPLE_TRUE = 21,
+  CBOR_SIMPLE_NULL = 22,
+  CBOR_BREAK = 0xFF,
+  JSON_CONTROL_LIMIT = 0x20,
+  JSON_ESCAPE_SIZE = 7,
+  JSON_UNICODE_DIGITS = 4,
+  HEX_DIGIT_BITS = 4,
+  NUMBER_STR_SIZE = 24
+};
+
+static void streamFlush(StreamWriter *writer) {
+  if (writer->len > 0 && writer->error == 0) {
+    writer->error = writer->sink(writer->buffer, writer->len, writer->ctx);
+  }
+  writer->len = 0;
+}
+
+static void streamWrite(StreamWriter *writer, const void *data, size_t len) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  if (writer->withCrc) {
+    writer->crc = settings_crc32(writer->crc, data, len);
+  }
+  while (len > 0 && writer->error == 0) {
+    size_t room = SETTINGS_STREAM_CHUNK_SIZE - writer->len;
+    size_t chunk = len < room ? len : room;
+    memcpy(writer->buffer + writer->len, bytes, chunk);
+    writer->len += chunk;
+    bytes += chunk;
+    len -= chunk;
+    if (writer->len == SETTINGS_STREAM_CHUNK_SIZE) {
+      streamFlush(writer);
+    }
+  }
+}
+
+static void streamWriteString(StreamWriter *writer, const char *str) {
+  streamWrite(writer, str, strlen(str));
+}
+
+// Boolean values are stored as text. Accept the same spellings as the CLI
+static bool valueIsTrue(const char *value) {
+  char lower[sizeof("true")] = {0};
+  for (size_t i = 0; i < sizeof(lower) - 1 && value[i] != '\0'; i++) {
+    lower[i] = (char)tolower((unsigned char)value[i]);
+  }
+  return strcmp(lower, "true") == 0 || strcmp(lower, "t") == 0 ||
+         strcmp(lower, "1") == 0;
+}
+
+static void exportJsonString(StreamWriter *writer, const char *str,
+                             size_t len) {
+  streamWrite(writer, "\"", 1);
+  for (size_t i = 0; i < len && str[i] != '\0'; i++) {
+    unsigned char chr = (unsigned char)str[i];
+    if (chr == '"' || chr == '\\') {
+      char escaped[2] = {'\\', (char)chr};
+      streamWrite(writer, escaped, sizeof(escaped));
+    } else if (chr < JSON_CONTROL_LIMIT) {
+      char escaped[JSON_ESCAPE_SIZE];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", chr);
+      streamWrite(writer, escaped, JSON_ESCAPE_SIZE - 1);
+    } else {
+      streamWrite(writer, &chr, 1);
+    }
+  }
+  streamWrite(writer, "\"", 1);
+}
+
+static void exportJsonEntry(StreamWriter *writer,
+                            const SettingsConfigEntry *entry, bool first) {
+  streamWriteString(writer, first ? "\n  " : ",\n  ");
+  exportJsonString(writer, entry->key, SETTINGS_MAX_KEY_LENGTH);
+  streamWriteString(writer, ": ");
+  switch (entry->dataType) {
+    case SETTINGS_TYPE_INT: {
+      char number[NUMBER_STR_SIZE];
+      snprintf(number, sizeof(number), "%ld",
+               strtol(entry->value, NULL, SETTINGS_BASE_10));
+      streamWriteString(writer, number);
+      break;
+    }
+    case SETTINGS_TYPE_BOOL:
+      streamWriteString(writer, valueIsTrue(entry->value) ? "true" : "false");
+      break;
+    default:
+      exportJsonString(writer, entry->value, SETTINGS_MAX_VALUE_LENGTH);
+      break;
+  }
+}
+
+static void cborWriteHeader(StreamWriter *writer, uint8_t major,
+                            uint64_t arg) {
+  uint8_t header[1 + sizeof(uint64_t)];
+  size_t argBytes = 0;
+  uint8_t info = (uint8_t)arg;
+  if (arg >= CBOR_INFO_UINT8) {
+    // Smallest of the 1, 2, 4 or 8 byte encodings that fits the argument
+    info = CBOR_INFO_UINT8;
+    argBytes = 1;
+    while (argBytes < sizeof(uint64_t) && (arg >> (8 * argBytes)) != 0) {
+      argBytes <<= 1;
+      info++;
+    }
+  }
+  header[0] = (uint8_t)(major << CBOR_MAJOR_SHIFT) | info;
+  for (size_t i = 0; i < argBytes; i++) {
+    header[1 + i] = (uint8_t)(arg >> (8 * (argBytes - 1 - i)));
+  }
+  streamWrite(writer, header, 1 + argBytes);
+}
+
+static void cborWriteText(StreamWriter *writer, const char *str,
+                          size_t maxLen) {
+  size_t len = strnlen(str, maxLen);
+  cborWriteHeader(writer, CBOR_MAJOR_TEXT, len);
+  streamWrite(writer, str, len);
+}
+
+static void exportCborEntry(StreamWriter *writer,
+                            const SettingsConfigEntry *entry) {
+  cborWriteText(writer, entry->key, SETTINGS_MAX_KEY_LENGTH);
+  switch (entry->dataType) {
+    case SETTINGS_TYPE_INT: {
+      long number = strtol(entry->value, NULL, SETTINGS_BASE_10);
+      if (number >= 0) {
+        cborWriteHeader(writer, CBOR_MAJOR_UINT, (uint64_t)number);
+      } else {
+        cborWriteHeader(writer, CBOR_MAJOR_NEGINT, (uint64_t)(-1 - number));
+      }
+      break;
+    }
+    case SETTINGS_TYPE_BOOL:
+      cborWriteHeader(writer, CBOR_MAJOR_SIMPLE,
+                      valueIsTrue(entry->value) ? CBOR_SIMPLE_TRUE
+                                                : CBOR_SIMPLE_FALSE);
+      break;
+    default:
+      cborWriteText(writer, entry->value, SETTINGS_MAX_VALUE_LENGTH);
+      break;
+  }
+}
+
+int settings_export(SettingsStreamFormat format, SettingsSinkFn sink,
+                    void *ctx) {
+  if (sink == NULL) {
+    return -1;
+  }
+  StreamWriter writer = {.sink = sink, .ctx = ctx};
+
+  if (format == SETTINGS_FORMAT_CBOR) {
+    size_t count = 0;
+    for (size_t i = 0; i < configData.count; i++) {
+      count += isMagicEntry(&configData.entries[i]) ? 0 : 1;
+    }
+    cborWriteHeader(&writer, CBOR_MAJOR_MAP, count);
+  } else {
+    streamWriteString(&writer, "{");
+  }
+
+  bool first = true;
+  for (size_t i = 0; i < configData.count && writer.error == 0; i++) {
+    const SettingsConfigEntry *entry = &configData.entries[i];
+    // The magic/version entry is internal and never exported or imported
+    if (isMagicEntry(entry)) {
+      continue;
+    }
+    if (format == SETTINGS_FORMAT_CBOR) {
+      exportCborEntry(&writer, entry);
+    } else {
+      exportJsonEntry(&writer, entry, first);
+    }
+    first = false;
+  }
+
+  if (format != SETTINGS_FORMAT_CBOR) {
+    streamWriteString(&writer, "\n}\n");
+  }
+  streamFlush(&writer);
+  if (writer.error != 0) {
+    DPRINTF("Export aborted by the sink (%d).\n", writer.error);
+  }
+  return writer.error;
+}
+
+// Streaming import. Both parsers share the key/value buffers of the context
+// and apply each pair as soon as it is complete.
+enum {
+  IMPORT_DONE = 0,
+  IMPORT_ERROR,
+  IMPORT_JSON_START,
+  IMPORT_JSON_FIRST_KEY,
+  IMPORT_JSON_KEY_START,
+  IMPORT_JSON_KEY,
+  IMPORT_JSON_COLON,
+  IMPORT_JSON_VALUE,
+  IMPORT_JSON_STRING,
+  IMPORT_JSON_LITERAL,
+  IMPORT_JSON_NEXT,
+  IMPORT_CBOR_MAP_HEADER,
+  IMPORT_CBOR_KEY_HEADER,
+  IMPORT_CBOR_KEY_BYTES,
+  IMPORT_CBOR_VALUE_HEADER,
+  IMPORT_CBOR_VALUE_BYTES
+};
+
+enum {
+  JSON_ESCAPE_NONE = 0,
+  JSON_ESCAPE_BACKSLASH = 1,
+  JSON_ESCAPE_UNICODE = 2  // Followed by the count of hex digits read
+};
+
+static void importAppend(SettingsImportContext *importCtx, bool toKey,
+                         char chr) {
+  char *buffer = toKey ? importCtx->key : importCtx->value;
+  size_t size = toKey ? SETTINGS_MAX_KEY_LENGTH : SETTINGS_MAX_VALUE_LENGTH;
+  size_t *len = toKey ? &importCtx->keyLen : &importCtx->valueLen;
+  if (*len < size - 1) {
+    buffer[(*len)++] = chr;
+  } else {
+    importCtx->overflow = true;
+  }
+}
+
+static void importStartPair(SettingsImportContext *importCtx) {
+  importCtx->keyLen = 0;
+  importCtx->valueLen = 0;
+  importCtx->overflow = false;
+  importCtx->subState = JSON_ESCAPE_NONE;
+}
+
+// Parse a base 10 integer that fills the whole string
+static int parseIntValue(const char *str, int *value) {
+  char *end = NULL;
+  errno = 0;
+  long number = strtol(str, &end, SETTINGS_BASE_10);
+  if (errno != 0 || *end != '\0' || end == str || number < INT_MIN ||
+      number > INT_MAX) {
+    return -1;
+  }
+  *value = (int)number;
+  return 0;
+}
+
+// Accept the same spellings as the CLI, and nothing else
+static int parseBoolValue(const char *str, bool *value) {
+  char lower[sizeof("false")] = {0};
+  for (size_t i = 0; str[i] != '\0'; i++) {
+    if (i == sizeof(lower) - 1) {
+      return -1;
+    }
+    lower[i] = (char)tolower((unsigned char)str[i]);
+  }
+  if (strcmp(lower, "true") == 0 || strcmp(lower, "t") == 0 ||
+      strcmp(lower, "1") == 0) {
+    *value = true;
+  } else if (strcmp(lower, "false") == 0 || strcmp(lower, "f") == 0 ||
+             strcmp(lower, "0") == 0) {
+    *value = false;
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+// Apply the parsed pair to the configuration. The value is converted to the
+// type of the default value of the key, whatever its type in the document.
+// Invalid pairs are skipped
+static void importApply(SettingsImportContext *importCtx) {
+  importCtx->key[importCtx->keyLen] = '\0';
+  importCtx->value[importCtx->valueLen] = '\0';
+
+  int err = -1;
+  SettingsConfigEntry defaultEntry;
+  if (importCtx->overflow) {
+    DPRINTF("Import: key or value too long for key %s.\n", importCtx->key);
+  } else if (!findDefaultEntry(importCtx->key, &defaultEntry)) {
+    DPRINTF("Import: unknown key %s.\n", importCtx->key);
+  } else if (isMagicEntry(&defaultEntry)) {
+    // The magic/version entry is internal and never exported or imported
+    DPRINTF("Import: ignoring %s.\n", SETTINGS_MAGICVERSION_KEY);
+  } else if (defaultEntry.dataType == SETTINGS_TYPE_INT) {
+    int number;
+    if (parseIntValue(importCtx->value, &number) == 0) {
+      err = settings_put_integer(importCtx->key, number);
+    } else {
+      DPRINTF("Import: invalid integer %s for key %s.\n", importCtx->value,
+              importCtx->key);
+    }
+  } else if (defaultEntry.dataType == SETTINGS_TYPE_BOOL) {
+    bool flag;
+    if (parseBoolValue(importCtx->value, &flag) == 0) {
+      err = settings_put_bool(importCtx->key, flag);
+    } else {
+      DPRINTF("Import: invalid boolean %s for key %s.\n", importCtx->value,
+              importCtx->key);
+    }
+  } else {
+    err = settings_put_string(importCtx->key, importCtx->value);
+  }
+
+  if (err == 0) {
+    importCtx->applied++;
+  } else {
+    importCtx->skipped++;
+  }
+}
+
+static int hexDigitValue(uint8_t chr) {
+  if (isdigit(chr)) {
+    return chr - '0';
+  }
+  chr = (uint8_t)tolower(chr);
+  if (chr >= 'a' && chr <= 'f') {
+    return chr - 'a' + SETTINGS_BASE_10;
+  }
+  return -1;
+}
+
+// Handle one character inside a JSON string. Returns true when the closing
+// quote has been consumed.
+static bool importJsonStringChar(SettingsImportContext *importCtx, bool toKey,
+                                 uint8_t chr) {
+  if (importCtx->subState == JSON_ESCAPE_BACKSLASH) {
+    static const char escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+    importCtx->subState = JSON_ESCAPE_NONE;
+    if (chr == 'u') {
+      importCtx->subState = JSON_ESCAPE_UNICODE;
+      importCtx->arg = 0;
+      return false;
+    }
+    for (size_t i = 0; i + 1 < sizeof(escapes); i += 2) {
+      if (escapes[i] == (char)chr) {
+        importAppend(importCtx, toKey, escapes[i + 1]);
+        return false;
+      }
+    }
+    importCtx->state = IMPORT_ERROR;
+    return false;
+  }
+  if (importCtx->subState >= JSON_ESCAPE_UNICODE) {
+    int digit = hexDigitValue(chr);
+    if (digit < 0) {
+      importCtx->state = IMPORT_ERROR;
+      return false;
+    }
+    importCtx->arg = (importCtx->arg << HEX_DIGIT_BITS) | (uint64_t)digit;
+    if (++importCtx->subState == JSON_ESCAPE_UNICODE + JSON_UNICODE_DIGITS) {
+      // Values are stored as single-byte text. Replace what does not fit
+      importAppend(importCtx, toKey,
+                   importCtx->arg <= SCHAR_MAX ? (char)importCtx->arg : '?');
+      importCtx->subState = JSON_ESCAPE_NONE;
+    }
+    return false;
+  }
+  if (chr == '\\') {
+    importCtx->subState = JSON_ESCAPE_BACKSLASH;
+    return false;
+  }
+  if (chr == '"') {
+    return true;
+  }
+  importAppend(importCtx, toKey, (char)chr);
+  return false;
+}
+
+static void importJsonLiteralEnd(SettingsImportContext *importCtx) {
+  importCtx->value[importCtx->valueLen] = '\0';
+  if (strcmp(importCtx->value, "null") == 0) {
+    importCtx->skipped++;
+  } else {
+    importApply(importCtx);
+  }
+  importCtx->state = IMPORT_JSON_NEXT;
+}
+
+static void importJsonByte(SettingsImportContext *importCtx, uint8_t chr) {
+  bool space = isspace(chr) != 0;
+  switch (importCtx->state) {
+    case IMPORT_JSON_START:
+      if (chr == '{') {
+        importCtx->state = IMPORT_JSON_FIRST_KEY;
+      } else if (!space) {
+        importCtx->state = IMPORT_ERROR;
+      }
+      break;
+    case IMPORT_JSON_FIRST_KEY:
+    case IMPORT_JSON_KEY_START:
+      if (chr == '"') {
+        importStartPair(importCtx);
+        importCtx->state = IMPORT_JSON_KEY;
+      } else if (chr == '}' && importCtx->state == IMPORT_JSON_FIRST_KEY) {
+        importCtx->state = IMPORT_DONE;
+      } else if (!space) {
+        importCtx->state = IMPORT_ERROR;
+      }
+      break;
+    case IMPORT_JSON_KEY:
+      if (importJsonStringChar(importCtx, true, chr)) {
+        importCtx->state = IMPORT_JSON_COLON;
+      }
+      break;
+    case IMPORT_JSON_COLON:
+      if (chr == ':') {
+        importCtx->state = IMPORT_JSON_VALUE;
+      } else if (!space) {
+        importCtx->state = IMPORT_ERROR;
+      }
+      break;
+    case IMPORT_JSON_VALUE:
+      if (chr == '"') {
+        importCtx->state = IMPORT_JSON_STRING;
+      } else if (isalnum(chr) || chr == '-' || chr == '+') {
+        importAppend(importCtx, false, (char)chr);
+        importCtx->state = IMPORT_JSON_LITERAL;
+      } else if (!space) {
+        importCtx->state = IMPORT_ERROR;
+      }
+      break;
+    case IMPORT_JSON_STRING:
+      if (importJsonStringChar(importCtx, false, chr)) {
+        importApply(importCtx);
+        importCtx->state = IMPORT_JSON_NEXT;
+      }
+      break;
+    case IMPORT_JSON_LITERAL:
+      if (isalnum(chr) || chr == '-' || chr == '+' || chr == '.') {
+        importAppend(importCtx, false, (char)chr);
+      } else {
+        importJsonLiteralEnd(importCtx);
+        importJsonByte(importCtx, chr);  // The terminator belongs to NEXT
+      }
+      break;
+    case IMPORT_JSON_NEXT:
+      if (chr == ',') {
+        importCtx->state = IMPORT_JSON_KEY_START;
+      } else if (chr == '}') {
+        importCtx->state = IMPORT_DONE;
+      } else if (!space) {
+        importCtx->state = IMPORT_ERROR;
+      }
+      break;
+    case IMPORT_DONE:
+      if (!space) {
+        importCtx->state = IMPORT_ERROR;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+static void importCborPairDone(SettingsImportContext *importCtx) {
+  importCtx->state = IMPORT_CBOR_KEY_HEADER;
+  if (!importCtx->indefinite && --importCtx->pairs == 0) {
+    importCtx->state = IMPORT_DONE;
+  }
+}
+
+// Called when a complete CBOR item header has been read
+static void importCborHeader(SettingsImportContext *importCtx) {
+  uint8_t major = importCtx->major;
+  uint64_t arg = importCtx->arg;
+  switch (importCtx->state) {
+    case IMPORT_CBOR_MAP_HEADER:
+      if (major != CBOR_MAJOR_MAP) {
+        importCtx->state = IMPORT_ERROR;
+      } else if (importCtx->indefinite || arg > 0) {
+        importCtx->pairs = arg;
+        importCtx->state = IMPORT_CBOR_KEY_HEADER;
+      } else {
+        importCtx->state = IMPORT_DONE;
+      }
+      break;
+    case IMPORT_CBOR_KEY_HEADER:
+      if (major != CBOR_MAJOR_TEXT) {
+        importCtx->state = IMPORT_ERROR;
+        break;
+      }
+      importStartPair(importCtx);
+      importCtx->remaining = arg;
+      importCtx->state =
+          arg > 0 ? IMPORT_CBOR_KEY_BYTES : IMPORT_CBOR_VALUE_HEADER;
+      break;
+    case IMPORT_CBOR_VALUE_HEADER:
+      if (major == CBOR_MAJOR_UINT || major == CBOR_MAJOR_NEGINT) {
+        if (arg > INT_MAX) {
+          importCtx->overflow = true;
+        } else {
+          snprintf(importCtx->value, sizeof(importCtx->value), "%ld",
+                   major == CBOR_MAJOR_UINT ? (long)arg : -1 - (long)arg);
+          importCtx->valueLen = strlen(importCtx->value);
+        }
+        importApply(importCtx);
+        importCborPairDone(importCtx);
+      } else if (major == CBOR_MAJOR_TEXT) {
+        importCtx->remaining = arg;
+        if (arg > 0) {
+          importCtx->state = IMPORT_CBOR_VALUE_BYTES;
+        } else {
+          importApply(importCtx);
+          importCborPairDone(importCtx);
+        }
+      } else if (major == CBOR_MAJOR_SIMPLE &&
+                 (arg == CBOR_SIMPLE_FALSE || arg == CBOR_SIMPLE_TRUE)) {
+        strcpy(importCtx->value, arg == CBOR_SIMPLE_TRUE ? "true" : "false");
+        importCtx->valueLen = strlen(importCtx->value);
+        importApply(importCtx);
+        importCborPairDone(importCtx);
+      } else if (major == CBOR_MAJOR_SIMPLE && arg == CBOR_SIMPLE_NULL) {
+        importCtx->skipped++;
+        importCborPairDone(importCtx);
+      } else {
+        // Nested items, byte strings and floats are not settings values
+        importCtx->state = IMPORT_ERROR;
+      }
+      break;
+    default:
+      importCtx->state = IMPORT_ERROR;
+      break;
+  }
+}
+
+static void importCborByte(SettingsImportContext *importCtx, uint8_t byte) {
+  switch (importCtx->state) {
+    case IMPORT_CBOR_MAP_HEADER:
+    case IMPORT_CBOR_KEY_HEADER:
+    case IMPORT_CBOR_VALUE_HEADER:
+      if (importCtx->need > 0) {
+        importCtx->arg = (importCtx->arg << 8) | byte;
+        if (--importCtx->need == 0) {
+          importCborHeader(importCtx);
+        }
+        break;
+      }
+      if (byte == CBOR_BREAK && importCtx->indefinite &&
+          importCtx->state == IMPORT_CBOR_KEY_HEADER) {
+        importCtx->state = IMPORT_DONE;
+        break;
+      }
+      importCtx->major = byte >> CBOR_MAJOR_SHIFT;
+      uint8_t info = byte & CBOR_INFO_MASK;
+      importCtx->arg = info;
+      if (info == CBOR_INFO_INDEFINITE &&
+          importCtx->state == IMPORT_CBOR_MAP_HEADER) {
+        importCtx->indefinite = true;
+        importCborHeader(importCtx);
+      } else if (info < CBOR_INFO_UINT8) {
+        importCborHeader(importCtx);
+      } else if (info <= CBOR_INFO_UINT64 &&
+                 importCtx->major != CBOR_MAJOR_SIMPLE) {
+        importCtx->arg = 0;
+        importCtx->need = (uint8_t)(1U << (info - CBOR_INFO_UINT8));
+      } else {
+        importCtx->state = IMPORT_ERROR;
+      }
+      break;
+    case IMPORT_CBOR_KEY_BYTES:
+    case IMPORT_CBOR_VALUE_BYTES: {
+      bool toKey = importCtx->state == IMPORT_CBOR_KEY_BYTES;
+      importAppend(importCtx, toKey, (char)byte);
+      if (--importCtx->remaining == 0) {
+        if (toKey) {
+          importCtx->state = IMPORT_CBOR_VALUE_HEADER;
+        } else {
+          importApply(importCtx);
+          importCborPairDone(importCtx);
+        }
+      }
+      break;
+    }
+    case IMPORT_DONE:
+      // Anything after the map is not part of the document
+      importCtx->state = IMPORT_ERROR;
+      break;
+    default:
+      break;
+  }
+}
+
+int settings_import_begin(SettingsImportContext *importCtx,
+                          SettingsStreamFormat format) {
+  if (importCtx == NULL) {
+    return -1;
+  }
+  memset(importCtx, 0, sizeof(SettingsImportContext));
+  importCtx->format = format;
+  importCtx->state = format == SETTINGS_FORMAT_CBOR ? IMPORT_CBOR_MAP_HEADER
+                                                    : IMPORT_JSON_START;
+  return 0;
+}
+
+int settings_import_feed(SettingsImportContext *importCtx, const uint8_t *data,
+                         size_t len) {
+  for (size_t i = 0; i < len && importCtx->state != IMPORT_ERROR; i++) {
+    if (importCtx->format == SETTINGS_FORMAT_CBOR) {
+      importCborByte(importCtx, data[i]);
+    } else {
+      importJsonByte(importCtx, data[i]);
+    }
+  }
+  if (importCtx->state == IMPORT_ERROR) {
+    DPRINTF("Import: malformed document.\n");
+    return -1;
+  }
+  return 0;
+}
+
+int settings_import_end(SettingsImportContext *importCtx) {
+  // A number at the very end of a JSON document has no terminator yet
+  if (importCtx->state == IMPORT_JSON_LITERAL) {
+    importJsonLiteralEnd(importCtx);
+  }
+  DPRINTF("Import: %d entries applied, %d skipped.\n", importCtx->applied,
+          importCtx->skipped);
+  return importCtx->state == IMPORT_DONE ? 0 : -1;
+}
+
+uint32_t settings_crc32(uint32_t crc, const void *data, size_t len) {
+  // Half-byte table: small enough for flash, fast enough for patches
+  static const uint32_t table[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+      0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+      0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+  const uint8_t *bytes = (const uint8_t *)data;
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc = table[(crc ^ bytes[i]) & 0x0F] ^ (crc >> 4);
+    crc = table[(crc ^ (bytes[i] >> 4)) & 0x0F] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+uint32_t settings_get_generation() { return settingsGeneration; }
+
+// Delta patches
+
+enum {
+  DELTA_MAGIC_0 = 'S',
+  DELTA_MAGIC_1 = 'P',
+  DELTA_OFFSET_VERSION = 2,
+  DELTA_OFFSET_STORE_MAGIC = 4,
+  DELTA_OFFSET_BASE = 8,
+  DELTA_OFFSET_COUNT = 12,
+  DELTA_RECORD_HEADER_SIZE = 3
+};
+
+static void writeLe32(uint8_t *dest, uint32_t value) {
+  for (size_t i = 0; i < sizeof(uint32_t); i++) {
+    dest[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static uint32_t readLe32(const uint8_t *src) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < sizeof(uint32_t); i++) {
+    value |= (uint32_t)src[i] << (8 * i);
+  }
+  return value;
+}
+
+// Find a key in an image with the flash layout. The image may be unaligned,
+// so entries are copied out.
+static bool findImageEntry(const uint8_t *image, size_t size, const char *key,
+                           SettingsConfigEntry *out) {
+  for (size_t offset = 0; offset + sizeof(SettingsConfigEntry) <= size;
+       offset += sizeof(SettingsConfigEntry)) {
+    memcpy(out, image + offset, sizeof(SettingsConfigEntry));
+    if (out->key[0] == '\0' ||
+        memchr(out->key, '\0', SETTINGS_MAX_KEY_LENGTH) == NULL ||
+        checkKeyFormat(out->key) != 0) {
+      return false;  // End of entries
+    }
+    if (strncmp(out->key, key, SETTINGS_MAX_KEY_LENGTH) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Decide which record, if any, brings the base entry to the current one. An
+// entry missing from the base image has its default value there.
+static int deltaRecordOp(const uint8_t *image, size_t size,
+                         const SettingsConfigEntry *entry) {
+  if (isMagicEntry(entry) ||
+      entryPolicy(entry - configData.entries) == SETTINGS_POLICY_VOLATILE) {
+    return 0;
+  }
+  SettingsConfigEntry defaultEntry;
+  bool hasDefault = findDefaultEntry(entry->key, &defaultEntry);
+  SettingsConfigEntry baseEntry;
+  if (!findImageEntry(image, size, entry->key, &baseEntry)) {
+    if (!hasDefault) {
+      return 0;
+    }
+    baseEntry = defaultEntry;
+  }
+  if (entryValueEquals(&baseEntry, entry)) {
+    return 0;
+  }
+  if (hasDefault && entryValueEquals(&defaultEntry, entry)) {
+    return SETTINGS_DELTA_OP_DEFAULT;
+  }
+  return SETTINGS_DELTA_OP_SET;
+}
+
+static void deltaWriteRecord(StreamWriter *writer, uint8_t op,
+                             const SettingsConfigEntry *entry) {
+  uint8_t keyLen = (uint8_t)strnlen(entry->key, SETTINGS_MAX_KEY_LENGTH);
+  uint8_t header[DELTA_RECORD_HEADER_SIZE] = {op, (uint8_t)entry->dataType,
+                                              keyLen};
+  streamWrite(writer, header, sizeof(header));
+  streamWrite(writer, entry->key, keyLen);
+  if (op == SETTINGS_DELTA_OP_SET) {
+    uint8_t valueLen =
+        (uint8_t)strnlen(entry->value, SETTINGS_MAX_VALUE_LENGTH - 1);
+    streamWrite(writer, &valueLen, 1);
+    streamWrite(writer, entry->value, valueLen);
+  }
+}
+
+int settings_delta_create(const uint8_t *baseImage, size_t baseSize,
+                          SettingsSinkFn sink, void *ctx) {
+  if (sink == NULL) {
+    return SETTINGS_DELTA_ERR_MALFORMED;
+  }
+  uint32_t baseGeneration = settingsGeneration;
+  uint8_t *imageCopy = NULL;  // Stored image, if not mapped in memory
+  if (baseImage == NULL && storageOps->map != NULL) {
+    baseImage = storageOps->map(storageCtx);
+    baseSize = flashSettingsSize;
+  } else if (baseImage == NULL) {
+    imageCopy = (uint8_t *)malloc(flashSettingsSize);
+    if (imageCopy == NULL ||
+        storageRead(0, imageCopy, flashSettingsSize) != 0) {
+      free(imageCopy);
+      return SETTINGS_DELTA_ERR_MALFORMED;
+    }
+    baseImage = imageCopy;
+    baseSize = flashSettingsSize;
+  } else {
+    SettingsConfigEntry magicEntry;
+    baseGeneration = SETTINGS_DELTA_ANY_GENERATION;
+    if (findImageEntry(baseImage, baseSize, SETTINGS_MAGICVERSION_KEY,
+                       &magicEntry)) {
+      magicEntry.value[SETTINGS_MAX_VALUE_LENGTH - 1] = '\0';
+      const char *generation =
+          strchr(magicEntry.value, SETTINGS_GENERATION_SEPARATOR);
+      baseGeneration = generation ? (uint32_t)strtoul(generation + 1, NULL,
+                                                      SETTINGS_BASE_10)
+                                  : 0;
+    }
+  }
+
+  uint16_t count = 0;
+  for (size_t i = 0; i < configData.count; i++) {
+    if (deltaRecordOp(baseImage, baseSize, &configData.entries[i]) != 0) {
+      count++;
+    }
+  }
+
+  StreamWriter writer = {.sink = sink, .ctx = ctx, .withCrc = true};
+  uint8_t header[SETTINGS_DELTA_HEADER_SIZE] = {
+      DELTA_MAGIC_0, DELTA_MAGIC_1, SETTINGS_DELTA_VERSION, 0};
+  writeLe32(&header[DELTA_OFFSET_STORE_MAGIC], configData.magic);
+  writeLe32(&header[DELTA_OFFSET_BASE], baseGeneration);
+  header[DELTA_OFFSET_COUNT] = (uint8_t)count;
+  header[DELTA_OFFSET_COUNT + 1] = (uint8_t)(count >> 8);
+  streamWrite(&writer, header, sizeof(header));
+
+  for (size_t i = 0; i < configData.count; i++) {
+    const SettingsConfigEntry *entry = &configData.entries[i];
+    int op = deltaRecordOp(baseImage, baseSize, entry);
+    if (op != 0) {
+      deltaWriteRecord(&writer, (uint8_t)op, entry);
+    }
+  }
+
+  uint8_t crc[SETTINGS_DELTA_CRC_SIZE];
+  writeLe32(crc, writer.crc);
+  writer.withCrc = false;
+  streamWrite(&writer, crc, sizeof(crc));
+  streamFlush(&writer);
+  free(imageCopy);
+  DPRINTF("Delta patch with %d records from generation %lu.\n", count,
+          baseGeneration);
+  return writer.error == 0 ? count : SETTINGS_DELTA_ERR_MALFORMED;
+}
+
+// Walk the records of a patch. The first pass only validates, the second one
+// applies, so a patch is either applied completely or not at all.
+static int deltaWalkRecords(const uint8_t *records, size_t len, uint16_t count,
+                            bool apply) {
+  size_t pos = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    if (pos + DELTA_RECORD_HEADER_SIZE > len) {
+      return SETTINGS_DELTA_ERR_MALFORMED;
+    }
+    uint8_t op = records[pos];
+    uint8_t type = records[pos + 1];
+    uint8_t keyLen = records[pos + 2];
+    pos += DELTA_RECORD_HEADER_SIZE;
+    if (keyLen == 0 || keyLen >= SETTINGS_MAX_KEY_LENGTH ||
+        pos + keyLen > len) {
+      return SETTINGS_DELTA_ERR_MALFORMED;
+    }
+    char key[SETTINGS_MAX_KEY_LENGTH] = {0};
+    memcpy(key, &records[pos], keyLen);
+    pos += keyLen;
+
+    const uint8_t *value = NULL;
+    uint8_t valueLen = 0;
+    if (op == SETTINGS_DELTA_OP_SET) {
+      if (pos + 1 > len) {
+        return SETTINGS_DELTA_ERR_MALFORMED;
+      }
+      valueLen = records[pos++];
+      if (valueLen >= SETTINGS_MAX_VALUE_LENGTH || pos + valueLen > len ||
+          checkTypeFormat((SettingsDataType)type) != 0) {
+        return SETTINGS_DELTA_ERR_MALFORMED;
+      }
+      value = &records[pos];
+      pos += valueLen;
+    } else if (op != SETTINGS_DELTA_OP_DEFAULT) {
+      return SETTINGS_DELTA_ERR_MALFORMED;
+    }
+
+    SettingsConfigEntry *entry = settings_find_entry(key);
+    SettingsConfigEntry defaultEntry;
+    if (entry == NULL || !findDefaultEntry(key, &defaultEntry) ||
+        isMagicEntry(entry) ||
+        (entryPolicies[entry - configData.entries] & SETTINGS_ENTRY_LOCKED)) {
+      DPRINTF("Delta patch references unknown key %s.\n", key);
+      return SETTINGS_DELTA_ERR_KEY;
+    }
+    // Patches never carry volatile keys, nor change the type of a key
+    if (entryPolicy(entry - configData.entries) == SETTINGS_POLICY_VOLATILE ||
+        (op == SETTINGS_DELTA_OP_SET && type != defaultEntry.dataType)) {
+      DPRINTF("Delta patch record for key %s not accepted.\n", key);
+      return SETTINGS_DELTA_ERR_KEY;
+    }
+
+    if (apply && op == SETTINGS_DELTA_OP_SET) {
+      entry->dataType = (SettingsDataType)type;
+      memcpy(entry->value, value, valueLen);
+      entry->value[valueLen] = '\0';
+      settingsNotifyChange(entry, true);
+    } else if (apply) {
+      entry->dataType = defaultEntry.dataType;
+      memcpy(entry->value, defaultEntry.value, SETTINGS_MAX_VALUE_LENGTH);
+      settingsNotifyChange(entry, true);
+    }
+  }
+  return pos == len ? 0 : SETTINGS_DELTA_ERR_MALFORMED;
+}
+
+int settings_delta_apply(const uint8_t *patch, size_t len) {
+  if (patch == NULL ||
+      len < SETTINGS_DELTA_HEADER_SIZE + SETTINGS_DELTA_CRC_SIZE) {
+    return SETTINGS_DELTA_ERR_MALFORMED;
+  }
+  size_t bodyLen = len - SETTINGS_DELTA_CRC_SIZE;
+  if (settings_crc32(0, patch, bodyLen) != readLe32(&patch[bodyLen]) ||
+      patch[0] != DELTA_MAGIC_0 || patch[1] != DELTA_MAGIC_1 ||
+      patch[DELTA_OFFSET_VERSION] != SETTINGS_DELTA_VERSION) {
+    DPRINTF("Delta patch header or CRC not valid.\n");
+    return SETTINGS_DELTA_ERR_MALFORMED;
+  }
+
+  uint32_t baseGeneration = readLe32(&patch[DELTA_OFFSET_BASE]);
+  if (readLe32(&patch[DELTA_OFFSET_STORE_MAGIC]) != configData.magic ||
+      (baseGeneration != SETTINGS_DELTA_ANY_GENERATION &&
+       baseGeneration != settingsGeneration)) {
+    DPRINTF("Delta patch base %lu does not match generation %lu.\n",
+            baseGeneration, settingsGeneration);
+    return SETTINGS_DELTA_ERR_BASE;
+  }
+
+  uint16_t count = (uint16_t)(patch[DELTA_OFFSET_COUNT] |
+                              (patch[DELTA_OFFSET_COUNT + 1] << 8));
+  const uint8_t *records = &patch[SETTINGS_DELTA_HEADER_SIZE];
+  size_t recordsLen = bodyLen - SETTINGS_DELTA_HEADER_SIZE;
+  int err = deltaWalkRecords(records, recordsLen, count, false);
+  if (err != 0) {
+    return err;
+  }
+  deltaWalkRecords(records, recordsLen, count, true);
+  DPRINTF("Delta patch with %d records applied.\n", count);
+
+  return settings_save() == 0 ? 0 : SETTINGS_DELTA_ERR_SAVE;
+}
+
+void settings_set_change_callback(SettingsChangeFn callback, void *ctx) {
+  changeCallback = callback;
+  changeCallbackCtx = ctx;
+}
+
+// Reload
+
+// Copy a value into an entry. Returns true if the entry changed
+static bool settingsReplaceValue(SettingsConfigEntry *entry,
+                                 const SettingsConfigEntry *source) {
+  if (entryValueEquals(entry, source)) {
+    return false;
+  }
+  entry->dataType = source->dataType;
+  memcpy(entry->value, source->value, SETTINGS_MAX_VALUE_LENGTH);
+  settingsNotifyChange(entry, false);
+  return true;
+}
+
+static bool settingsRecordInChangedSector(uint16_t record,
+                                          const bool *changedSectors) {
+  size_t first = (size_t)record * sizeof(SettingsConfigEntry);
+  size_t last = first + sizeof(SettingsConfigEntry) - 1;
+  for (size_t sector = first / SETTINGS_FLASH_PAGE_SIZE;
+       sector <= last / SETTINGS_FLASH_PAGE_SIZE; sector++) {
+    if (changedSectors[sector]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int settings_reload() {
+  if (configData.entries == NULL) {
+    return -1;
+  }
+  size_t numSectors = flashSettingsSize / SETTINGS_FLASH_PAGE_SIZE;
+  bool *changedSectors = (bool *)calloc(numSectors, sizeof(bool));
+  if (changedSectors == NULL) {
+    return -1;
+  }
+
+  size_t numChanged = 0;
+  for (size_t i = 0; i < numSectors; i++) {
+    uint32_t crc = settingsSectorCrc(i);
+    if (crc != sectorCrcs[i]) {
+      changedSectors[i] = true;
+      sectorCrcs[i] = crc;
+      numChanged++;
+    }
+  }
+  if (numChanged == 0) {
+    free(changedSectors);
+    return 0;
+  }
+  DPRINTF("%d of %d sectors changed in FLASH.\n", numChanged, numSectors);
+
+  // The magic entry lives in the first sector. Without a valid one there are
+  // no settings in flash: every record is gone.
+  uint16_t numRecords = 0;
+  if (changedSectors[0] && !settingsReadFlashMagic(&settingsGeneration)) {
+    settingsGeneration = 0;
+    for (size_t i = 0; i < numSectors; i++) {
+      changedSectors[i] = true;
+    }
+  } else {
+    numRecords = (uint16_t)configDefaultsCount;
+  }
+
+  // Entries loaded from a record that changed must be found again
+  for (size_t i = 0; i < configData.count; i++) {
+    if (entryRecords[i] != SETTINGS_NO_RECORD &&
+        settingsRecordInChangedSector(entryRecords[i], changedSectors)) {
+      entryRecords[i] = SETTINGS_STALE_RECORD;
+    }
+  }
+
+  int changes = 0;
+  uint16_t record = 0;
+  for (; record < numRecords; record++) {
+    if (!settingsRecordInChangedSector(record, changedSectors)) {
+      if (record >= imageRecords) {
+        break;  // The end of the image has not moved
+      }
+      continue;
+    }
+    SettingsConfigEntry stored = {0};
+    if (!settingsReadFlashRecord(record, &stored)) {
+      break;
+    }
+    char keyStr[SETTINGS_MAX_KEY_LENGTH + 1] = {0};
+    strncpy(keyStr, stored.key, SETTINGS_MAX_KEY_LENGTH);
+    SettingsConfigEntry *entry = settings_find_entry(keyStr);
+    if (entry == NULL) {
+      continue;
+    }
+    size_t index = entry - configData.entries;
+    if (entryPolicy(index) == SETTINGS_POLICY_VOLATILE) {
+      continue;
+    }
+    entryRecords[index] = record;
+    entryCrcs[index] = settings_crc32(0, &stored, sizeof(stored));
+    entryDirty[index] = false;
+    if (!isMagicEntry(entry) && settingsReplaceValue(entry, &stored)) {
+      changes++;
+    }
+    settingsLockWriteOnce(index);
+  }
+  imageRecords = record;
+
+  // Entries not found in the new image are back to their default value
+  for (size_t i = 0; i < configData.count; i++) {
+    SettingsConfigEntry *entry = &configData.entries[i];
+    if (entryRecords[i] == SETTINGS_NO_RECORD ||
+        (entryRecords[i] != SETTINGS_STALE_RECORD &&
+         entryRecords[i] < imageRecords)) {
+      continue;
+    }
+    entryRecords[i] = SETTINGS_NO_RECORD;
+    entryDirty[i] = false;
+    SettingsConfigEntry defaultEntry;
+    if (!isMagicEntry(entry) && findDefaultEntry(entry->key, &defaultEntry) &&
+        settingsReplaceValue(entry, &defaultEntry)) {
+      changes++;
+    }
+  }
+
+  free(changedSectors);
+  // In place, the CRCs only cover the image up to its end, which may have moved
+  if (storageOps->inPlace) {
+    settingsUpdateSectorCrcs();
+  }
+  DPRINTF("Reloaded %d changed entries from FLASH.\n", changes);
+  return changes;
+}
+
+int settings_reset_to_defaults() {
+  if (configData.entries == NULL) {
+    return -1;
+  }
+
+  int error = storageOps->invalidate != NULL
+                  ? storageOps->invalidate(storageCtx)
+                  : storageOps->erase(storageCtx);
+  if (error != 0) {
+    return -1;
+  }
+
+  // The generation is kept: the next save continues the sequence
+  for (size_t i = 0; i < configData.count; i++) {
+    SettingsConfigEntry *entry = &configData.entries[i];
+    SettingsConfigEntry defaultEntry;
+    entryRecords[i] = SETTINGS_NO_RECORD;
+    if (!isMagicEntry(entry) && entryPolicy(i) != SETTINGS_POLICY_WRITE_ONCE &&
+        findDefaultEntry(entry->key, &defaultEntry)) {
+      settingsReplaceValue(entry, &defaultEntry);
+      entryDirty[i] = false;
+    }
+  }
+  imageRecords = 0;
+  settingsUpdateSectorCrcs();
+
+  DPRINTF("Settings reset to defaults. FLASH image invalidated.\n");
+  return 0;
+}
+
+// Policies
+
+// Lock a write-once entry stored with a value other than its default one. An
+// entry stored with its default value, like a serial number not provisioned
+// yet, can still be written once
+static void settingsLockWriteOnce(size_t index) {
+  SettingsConfigEntry defaultEntry;
+  if (entryPolicy(index) == SETTINGS_POLICY_WRITE_ONCE &&
+      findDefaultEntry(configData.entries[index].key, &defaultEntry) &&
+      !entryValueEquals(&configData.entries[index], &defaultEntry)) {
+    entryPolicies[index] |= SETTINGS_ENTRY_LOCKED;
+  }
+}
+
+static void settingsApplyPolicies() {
+  for (size_t i = 0; i < configData.count; i++) {
+    entryPolicies[i] = SETTINGS_POLICY_PERSISTENT;
+  }
+  for (size_t i = 0; i < keyPoliciesCount; i++) {
+    SettingsConfigEntry *entry = settings_find_entry(keyPolicies[i].key);
+    if (entry == NULL || isMagicEntry(entry)) {
+      DPRINTF("WARNING: Policy for unknown key %s.\n", keyPolicies[i].key);
+      continue;
+    }
+    size_t index = entry - configData.entries;
+    entryPolicies[index] = (uint8_t)keyPolicies[i].policy;
+    if (entryRecords[index] == SETTINGS_NO_RECORD) {
+      continue;
+    }
+    // The entry was loaded from flash
+    if (keyPolicies[i].policy == SETTINGS_POLICY_VOLATILE) {
+      SettingsConfigEntry defaultEntry;
+      entryRecords[index] = SETTINGS_NO_RECORD;
+      if (findDefaultEntry(entry->key, &defaultEntry)) {
+        settingsReplaceValue(entry, &defaultEntry);
+      }
+    } else if (!entryDirty[index]) {
+      settingsLockWriteOnce(index);
+    }
+  }
+}
+
+int settings_set_policies(const SettingsKeyPolicy *policies,
+                          size_t numPolicies) {
+  keyPolicies = policies;
+  keyPoliciesCount = policies != NULL ? numPolicies : 0;
+  int err = 0;
+  for (size_t i = 0; i < keyPoliciesCount; i++) {
+    if (policies[i].policy != SETTINGS_POLICY_PERSISTENT &&
+        policies[i].policy != SETTINGS_POLICY_VOLATILE &&
+        policies[i].policy != SETTINGS_POLICY_WRITE_ONCE) {
+      DPRINTF("Error: Invalid policy for key %s.\n", policies[i].key);
+      err = -1;
+    }
+  }
+  if (err != 0) {
+    keyPolicies = NULL;
+    keyPoliciesCount = 0;
+    return err;
+  }
+  if (configData.entries != NULL) {
+    settingsApplyPolicies();
+    for (size_t i = 0; i < keyPoliciesCount; i++) {
+      if (settings_find_entry(policies[i].key) == NULL) {
+        err = -1;
+      }
+    }
+  }
+  return err;
+}
+
+void settings_get_stats(SettingsStats *stats) {
+  memset(stats, 0, sizeof(SettingsStats));
+  for (size_t i = 0; i < configData.count; i++) {
+    stats->entries += isMagicEntry(&configData.entries[i]) ? 0 : 1;
+  }
+  stats->maxEntries =
+      (uint16_t)(flashSettingsSize / sizeof(SettingsConfigEntry));
+  stats->persistedEntries = imageRecords;
+  stats->flashOffset = flashSettingsOffset;
+  stats->flashSize = flashSettingsSize;
+  stats->generation = settingsGeneration;
+  stats->lastSaveUs = lastSaveUs;
+  stats->lastSaveIrqOffUs = lastSaveIrqOffUs;
+}
+
+// Cursor over copies of the entries
+
+bool settings_iter_read(SettingsIterator *iter, SettingsEntryInfo *info) {
+  const SettingsConfigEntry *entry = settings_iter_next(iter);
+  if (entry == NULL) {
+    return false;
+  }
+  memset(info, 0, sizeof(SettingsEntryInfo));
+  memcpy(info->key, entry->key, SETTINGS_MAX_KEY_LENGTH);
+  info->dataType = entry->dataType;
+  memcpy(info->value, entry->value, SETTINGS_MAX_VALUE_LENGTH);
+  info->value[SETTINGS_MAX_VALUE_LENGTH - 1] = '\0';
+  if (entry->dataType == SETTINGS_TYPE_INT &&
+      parseIntValue(info->value, &info->intValue) != 0) {
+    info->intValue = 0;
+  } else if (entry->dataType == SETTINGS_TYPE_BOOL) {
+    info->boolValue = valueIsTrue(info->value);
+  }
+  info->dirty = entryDirty[entry - configData.entries];
+  return true;
+}
+
+int settings_foreach(const char *prefix, uint8_t filter, SettingsVisitFn visit,
+                     void *ctx) {
+  SettingsIterator iter;
+  SettingsEntryInfo info;
+  settings_iter_begin(&iter, prefix);
+  settings_iter_filter(&iter, filter);
+  while (settings_iter_read(&iter, &info)) {
+    int result = visit(&info, ctx);
+    if (result != 0) {
+      return result;
+    }
+  }
+  return 0;
+}
+
+// INI loader. Lines are parsed byte by byte as the file is read, so only the
+// current section, key and value are kept in memory
+enum {
+  INI_LINE_START = 0,
+  INI_SECTION,
+  INI_KEY,
+  INI_VALUE_START,
+  INI_VALUE,
+  INI_SKIP  // Comment, end of a section line or line with an error
+};
+
+typedef struct {
+  SettingsIniErrorFn errorFn;
+  void *ctx;
+  int state;
+  unsigned line;
+  int errors;
+  bool overflow;    // Current section, key or value too long
+  bool badSection;  // The keys of the current section are skipped
+  size_t bomLen;    // Bytes of the UTF-8 byte order mark skipped
+  size_t sectionLen;
+  size_t keyLen;
+  size_t keyEnd;  // Length of the key without trailing spaces
+  size_t valueLen;
+  size_t valueEnd;  // Length of the value without trailing spaces
+  char section[SETTINGS_MAX_KEY_LENGTH];
+  char key[SETTINGS_MAX_KEY_LENGTH];
+  char value[SETTINGS_MAX_VALUE_LENGTH];
+} IniParser;
+
+// Byte order mark added by some editors at the start of the file
+static const uint8_t iniUtf8Bom[] = {0xEF, 0xBB, 0xBF};
+
+static void iniError(IniParser *parser, const char *message) {
+  DPRINTF("INI line %u: %s.\n", parser->line, message);
+  if (parser->errorFn != NULL) {
+    parser->errorFn(parser->line, message, parser->ctx);
+  }
+  parser->errors++;
+  parser->state = INI_SKIP;
+}
+
+static void iniAppend(IniParser *parser, char *buffer, size_t size,
+                      size_t *len, uint8_t chr) {
+  if (*len < size - 1) {
+    buffer[(*len)++] = (char)chr;
+  } else {
+    parser->overflow = true;
+  }
+}
+
+static void iniApply(IniParser *parser) {
+  if (parser->overflow) {
+    iniError(parser, "value too long");
+    return;
+  }
+  char *value = parser->value;
+  value[parser->valueEnd] = '\0';
+  if (parser->valueEnd >= 2 && value[0] == '"' &&
+      value[parser->valueEnd - 1] == '"') {
+    value[parser->valueEnd - 1] = '\0';
+    value++;
+  }
+
+  SettingsConfigEntry defaultEntry;
+  if (!findDefaultEntry(parser->key, &defaultEntry) ||
+      isMagicEntry(&defaultEntry)) {
+    iniError(parser, "unknown key");
+    return;
+  }
+
+  int err;
+  if (defaultEntry.dataType == SETTINGS_TYPE_INT) {
+    int number;
+    if (parseIntValue(value, &number) != 0) {
+      iniError(parser, "invalid integer");
+      return;
+    }
+    err = settings_put_integer(parser->key, number);
+  } else if (defaultEntry.dataType == SETTINGS_TYPE_BOOL) {
+    bool flag;
+    if (parseBoolValue(value, &flag) != 0) {
+      iniError(parser, "invalid boolean");
+      return;
+    }
+    err = settings_put_bool(parser->key, flag);
+  } else {
+    err = settings_put_string(parser->key, value);
+  }
+  if (err != 0) {
+    iniError(parser, "key rejected");
+  }
+}
+
+static void iniEndLine(IniParser *parser) {
+  switch (parser->state) {
+    case INI_SECTION:
+      iniError(parser, "unterminated section");
+      parser->badSection = true;
+      break;
+    case INI_KEY:
+      iniError(parser, "missing '='");
+      break;
+    case INI_VALUE_START:
+    case INI_VALUE:
+      iniApply(parser);
+      break;
+    default:
+      break;
+  }
+  parser->state = INI_LINE_START;
+}
+
+static void iniStartKey(IniParser *parser, uint8_t chr) {
+  parser->state = INI_KEY;
+  parser->overflow = false;
+  parser->keyLen = 0;
+  if (parser->badSection) {
+    iniError(parser, "key in an invalid section");
+    return;
+  }
+  if (parser->sectionLen > 0) {
+    memcpy(parser->key, parser->section, parser->sectionLen);
+    parser->keyLen = parser->sectionLen;
+    parser->key[parser->keyLen++] = SETTINGS_INI_SECTION_SEPARATOR;
+  }
+  iniAppend(parser, parser->key, sizeof(parser->key), &parser->keyLen, chr);
+  parser->keyEnd = parser->keyLen;
+}
+
+static void iniByte(IniParser *parser, uint8_t chr) {
+  if (chr == '\n') {
+    iniEndLine(parser);
+    parser->line++;
+    return;
+  }
+  switch (parser->state) {
+    case INI_LINE_START:
+      if (isspace(chr)) {
+        break;
+      }
+      if (parser->line == 1 && parser->bomLen < sizeof(iniUtf8Bom) &&
+          chr == iniUtf8Bom[parser->bomLen]) {
+        parser->bomLen++;
+      } else if (chr == ';' || chr == '#') {
+        parser->state = INI_SKIP;
+      } else if (chr == '[') {
+        parser->state = INI_SECTION;
+        parser->overflow = false;
+        parser->sectionLen = 0;
+      } else if (chr == '=') {
+        iniError(parser, "missing key");
+      } else {
+        iniStartKey(parser, chr);
+      }
+      break;
+    case INI_SECTION:
+      if (chr != ']') {
+        // Leave room for the separator and a key
+        iniAppend(parser, parser->section, sizeof(parser->section) - 2,
+                  &parser->sectionLen, chr);
+      } else if (parser->overflow) {
+        parser->badSection = true;
+        iniError(parser, "section too long");
+      } else {
+        parser->section[parser->sectionLen] = '\0';
+        parser->badSection = false;
+        parser->state = INI_SKIP;
+      }
+      break;
+    case INI_KEY:
+      if (chr != '=') {
+        iniAppend(parser, parser->key, sizeof(parser->key), &parser->keyLen,
+                  chr);
+        parser->keyEnd = isspace(chr) ? parser->keyEnd : parser->keyLen;
+      } else if (parser->overflow) {
+        iniError(parser, "key too long");
+      } else {
+        parser->key[parser->keyEnd] = '\0';
+        parser->state = INI_VALUE_START;
+        parser->valueLen = 0;
+        parser->valueEnd = 0;
+      }
+      break;
+    case INI_VALUE_START:
+      if (isspace(chr)) {
+        break;
+      }
+      parser->state = INI_VALUE;
+      // fall through
+    case INI_VALUE:
+      iniAppend(parser, parser->value, sizeof(parser->value),
+                &parser->valueLen, chr);
+      parser->valueEnd = isspace(chr) ? parser->valueEnd : parser->valueLen;
+      break;
+    default:
+      break;
+  }
+}
+
+int settings_load_ini(SettingsReadFn readFn, SettingsIniErrorFn errorFn,
+                      void *ctx) {
+  if (readFn == NULL) {
+    return -1;
+  }
+  IniParser parser = {.errorFn = errorFn, .ctx = ctx, .line = 1};
+  uint8_t chunk[SETTINGS_STREAM_CHUNK_SIZE];
+  int len;
+  while ((len = readFn(chunk, sizeof(chunk), ctx)) > 0) {
+    for (int i = 0; i < len; i++) {
+      iniByte(&parser, chunk[i]);
+    }
+  }
+  if (len < 0) {
+    DPRINTF("INI: read error at line %u.\n", parser.line);
+    return -1;
+  }
+  iniEndLine(&parser);  // The last line may have no newline
+  DPRINTF("INI: %u lines read, %d skipped.\n", parser.line, parser.errors);
+  return parser.errors;
+}
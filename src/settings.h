@@ -13,7 +13,10 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,6 +25,11 @@
 #include <hardware/resets.h>
 #include <hardware/sync.h>
 #include <hardware/watchdog.h>
+#include <pico/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /**
  * @brief Debug macro for printing formatted debug messages.
@@ -93,12 +101,37 @@
  */
 #define SETTINGS_MAGICVERSION_KEY "MAGICVERSION"
 
+/**
+ * @brief Separator between the magic value and the generation.
+ *
+ * The value of the magic entry is "<magic>:<generation>", where the generation
+ * counts the number of times the settings have been saved. Images without a
+ * generation are read as generation 0.
+ */
+#define SETTINGS_GENERATION_SEPARATOR ':'
+
 #define SETTINGS_FLASH_PAGE_SIZE 4096
 #define SETTINGS_DEFAULT_FLASH_SIZE 4096
 
 #define SETTINGS_BASE_10 10
 #define SETTINGS_SHIFT_LEFT_16_BITS 16
 
+/**
+ * @brief Size of the buffer used to stream exported settings.
+ *
+ * The exporter never holds more than this number of bytes before handing them
+ * to the sink callback, so the memory used does not depend on the number of
+ * entries.
+ */
+#define SETTINGS_STREAM_CHUNK_SIZE 64
+
+/**
+ * @brief Separator between the section and the key in INI files.
+ *
+ * The key "SSID" in the section "[WIFI]" is loaded as "WIFI_SSID".
+ */
+#define SETTINGS_INI_SECTION_SEPARATOR '_'
+
 /**
  * @brief Enumeration of possible data types for configuration entries.
  */
@@ -108,6 +141,94 @@ typedef enum {
   SETTINGS_TYPE_BOOL = 2    ///< Boolean type setting
 } SettingsDataType;
 
+/**
+ * @brief Binary delta patch format.
+ *
+ * A patch is a header, a list of records and a CRC32 of everything before it.
+ * All multi-byte fields are little endian.
+ *
+ * Header (14 bytes):
+ * - 2 bytes: "SP"
+ * - 1 byte: format version (SETTINGS_DELTA_VERSION)
+ * - 1 byte: reserved, 0
+ * - 4 bytes: magic value of the store (magic << 16 | version)
+ * - 4 bytes: base generation, or SETTINGS_DELTA_ANY_GENERATION
+ * - 2 bytes: number of records
+ *
+ * Record:
+ * - 1 byte: operation (SettingsDeltaOp)
+ * - 1 byte: data type (SettingsDataType)
+ * - 1 byte: key length, followed by the key without terminator
+ * - 1 byte: value length, followed by the value without terminator. Only
+ *   present in SETTINGS_DELTA_OP_SET records.
+ */
+#define SETTINGS_DELTA_VERSION 1
+#define SETTINGS_DELTA_HEADER_SIZE 14
+#define SETTINGS_DELTA_CRC_SIZE 4
+#define SETTINGS_DELTA_ANY_GENERATION 0xFFFFFFFFU
+
+/**
+ * @brief Operations of the records of a delta patch.
+ */
+typedef enum {
+  SETTINGS_DELTA_OP_SET = 1,    ///< Set the key to the given type and value
+  SETTINGS_DELTA_OP_DEFAULT = 2 ///< Restore the default value of the key
+} SettingsDeltaOp;
+
+/**
+ * @brief Error codes returned by settings_delta_apply().
+ */
+enum {
+  SETTINGS_DELTA_ERR_MALFORMED = -1, ///< Bad header, record or CRC
+  SETTINGS_DELTA_ERR_BASE = -2,      ///< Store is not at the base generation
+  SETTINGS_DELTA_ERR_KEY = -3,       ///< Unknown, volatile or write-once key,
+                                     ///< or a value of another type
+  SETTINGS_DELTA_ERR_SAVE = -4       ///< Patch applied but not saved
+};
+
+/**
+ * @brief Formats supported by the streaming exporter and importer.
+ */
+typedef enum {
+  SETTINGS_FORMAT_JSON = 0, ///< Flat JSON object, one key per line
+  SETTINGS_FORMAT_CBOR = 1  ///< CBOR map of text keys (RFC 8949)
+} SettingsStreamFormat;
+
+/**
+ * @brief Sink callback used by the streaming exporter.
+ *
+ * Called with consecutive chunks of the exported document. The chunks are at
+ * most SETTINGS_STREAM_CHUNK_SIZE bytes long and are only valid during the
+ * call.
+ *
+ * @param data Pointer to the chunk of data.
+ * @param len Number of bytes in the chunk.
+ * @param ctx User context given to settings_export().
+ * @return int 0 to continue, non-zero to abort the export.
+ */
+typedef int (*SettingsSinkFn)(const uint8_t *data, size_t len, void *ctx);
+
+/**
+ * @brief Read callback used by the INI loader.
+ *
+ * @param buffer Buffer to fill.
+ * @param size Size of the buffer.
+ * @param ctx User context given to settings_load_ini().
+ * @return int Number of bytes read, 0 at the end of the file, or negative on
+ * error.
+ */
+typedef int (*SettingsReadFn)(uint8_t *buffer, size_t size, void *ctx);
+
+/**
+ * @brief Error callback used by the INI loader.
+ *
+ * @param line Number of the line with the error, starting at 1.
+ * @param message Description of the error.
+ * @param ctx User context given to settings_load_ini().
+ */
+typedef void (*SettingsIniErrorFn)(unsigned line, const char *message,
+                                   void *ctx);
+
 /**
  * @brief Structure representing a single configuration entry.
  *
@@ -122,6 +243,27 @@ typedef struct {
                                          ///< as a string)
 } SettingsConfigEntry;
 
+/**
+ * @brief Persistence policy of a configuration entry.
+ */
+typedef enum {
+  SETTINGS_POLICY_PERSISTENT = 0, ///< Saved to flash (default)
+  SETTINGS_POLICY_VOLATILE = 1,   ///< Kept in RAM only, never saved
+  SETTINGS_POLICY_WRITE_ONCE = 2  ///< Saved once with a value, then fixed
+} SettingsPersistPolicy;
+
+/**
+ * @brief Persistence policy of a key.
+ *
+ * Policies are declared in a table next to the default entries. Keys not in
+ * the table are SETTINGS_POLICY_PERSISTENT. The policy is not part of
+ * SettingsConfigEntry so the layout of the entries in flash does not change.
+ */
+typedef struct {
+  const char *key;              ///< The configuration key
+  SettingsPersistPolicy policy; ///< The persistence policy of the key
+} SettingsKeyPolicy;
+
 /**
  * @brief Structure representing the overall configuration data.
  *
@@ -138,6 +280,138 @@ typedef struct {
   size_t count;                 ///< Number of configuration entries
 } ConfigData;
 
+/**
+ * @brief Callback invoked when the value or type of an entry changes.
+ *
+ * Called after the entry has been updated in RAM, from the context of the
+ * function that changed it (settings_put_*, imports, delta patches and
+ * settings_reload()).
+ *
+ * @param entry The entry that changed.
+ * @param ctx User context given to settings_set_change_callback().
+ */
+typedef void (*SettingsChangeFn)(const SettingsConfigEntry *entry, void *ctx);
+
+/**
+ * @brief Iterator over the entries whose key starts with a prefix.
+ *
+ * The members are private.
+ */
+typedef struct {
+  size_t next;    ///< Position of the next entry in the key index
+  size_t end;     ///< Position after the last entry
+  uint8_t filter; ///< SettingsFilter flags
+} SettingsIterator;
+
+/**
+ * @brief Filters of the entries returned by an iterator, combined with |.
+ *
+ * With any of the type flags, only entries of those types are returned. With
+ * SETTINGS_FILTER_DIRTY, only entries changed since they were last loaded or
+ * saved. Volatile entries are never saved, so they stay dirty once changed.
+ */
+typedef enum {
+  SETTINGS_FILTER_NONE = 0,                           ///< All the entries
+  SETTINGS_FILTER_INT = 1 << SETTINGS_TYPE_INT,       ///< Integer entries
+  SETTINGS_FILTER_STRING = 1 << SETTINGS_TYPE_STRING, ///< String entries
+  SETTINGS_FILTER_BOOL = 1 << SETTINGS_TYPE_BOOL,     ///< Boolean entries
+  SETTINGS_FILTER_DIRTY = 0x80                        ///< Unsaved entries
+} SettingsFilter;
+
+/**
+ * @brief Copy of an entry returned by settings_iter_read().
+ *
+ * The value is also given already parsed for its type, so readers do not
+ * convert the text themselves.
+ */
+typedef struct {
+  char key[SETTINGS_MAX_KEY_LENGTH + 1]; ///< Key, null terminated
+  SettingsDataType dataType;             ///< Data type of the entry
+  char value[SETTINGS_MAX_VALUE_LENGTH]; ///< Value as text
+  int intValue;   ///< Value of SETTINGS_TYPE_INT entries, 0 otherwise
+  bool boolValue; ///< Value of SETTINGS_TYPE_BOOL entries, false otherwise
+  bool dirty;     ///< Changed since it was last loaded or saved
+} SettingsEntryInfo;
+
+/**
+ * @brief Callback invoked by settings_foreach() for each entry.
+ *
+ * The callback can change settings, but not add or remove entries.
+ *
+ * @param info Copy of the entry.
+ * @param ctx User context given to settings_foreach().
+ * @return int 0 to continue, non-zero to stop the iteration.
+ */
+typedef int (*SettingsVisitFn)(const SettingsEntryInfo *info, void *ctx);
+
+/**
+ * @brief Statistics of the settings manager.
+ */
+typedef struct {
+  uint16_t entries;          ///< Number of entries, without the magic entry
+  uint16_t maxEntries;       ///< Maximum number of entries of the region
+  uint16_t persistedEntries; ///< Entries in the image in flash, with magic
+  uint32_t flashOffset;      ///< Offset of the settings region in flash
+  uint32_t flashSize;        ///< Size of the settings region in flash
+  uint32_t generation;       ///< Generation of the settings in flash
+  uint32_t lastSaveUs;       ///< Duration of the last save, in us
+  uint32_t lastSaveIrqOffUs; ///< Write window of the last save, in us. With
+                             ///< the flash, time in lockout windows
+} SettingsStats;
+
+/**
+ * @brief Storage of the settings image.
+ *
+ * By default the image is stored in the flash memory of the microcontroller.
+ * Other storages implement these operations and are selected with
+ * settings_set_storage(). Offsets are relative to the start of the image, and
+ * the size of the image is the flash size given to settings_init(). All the
+ * operations return 0 on success and non-zero on error.
+ *
+ * A save calls begin(), then write() with consecutive pages of FLASH_PAGE_SIZE
+ * bytes from offset 0, and finally end(). If a write fails, end() is called
+ * with commit set to false and the storage must keep the previous image if it
+ * can. With the flash storage, the interrupts are disabled from begin() to
+ * end().
+ *
+ * Storages that can be written at any offset without erasing, like FRAM or
+ * EEPROM, set inPlace. Their saves only write the records changed since
+ * they were last loaded or saved, one record at a time, without reading them
+ * back, and begin() and end() are optional. The magic entry is written last,
+ * so its generation only changes once the rest of the records are written.
+ * settings_reload() only checks the records up to the end of the image.
+ */
+typedef struct {
+  /// Read bytes of the image. Bytes never written read as zero or 0xFF.
+  int (*read)(uint32_t offset, void *buffer, size_t len, void *ctx);
+  /// Pointer to the image mapped in memory, or NULL. Optional.
+  const uint8_t *(*map)(void *ctx);
+  /// Start writing a new image.
+  int (*begin)(void *ctx);
+  /// Write a page of the new image.
+  int (*write)(uint32_t offset, const void *data, size_t len, void *ctx);
+  /// Finish writing the new image. It replaces the previous one if commit.
+  int (*end)(bool commit, void *ctx);
+  /// Remove the image.
+  int (*erase)(void *ctx);
+  /// Make the image unreadable, faster than erase(). Optional.
+  int (*invalidate)(void *ctx);
+  /// Written in place, without erasing. Saves only write changed records.
+  bool inPlace;
+} SettingsStorageOps;
+
+/**
+ * @brief Select the storage of the settings image.
+ *
+ * Must be called before settings_init(). The flash offset given to
+ * settings_init() is only used by the flash storage.
+ *
+ * @param ops Operations of the storage, or NULL for the flash memory. Not
+ * copied: must remain valid while the settings manager is in use.
+ * @param ctx User context passed to the operations.
+ */
+void settings_set_storage(const SettingsStorageOps *ops, void *ctx);
+
 /**
  * @brief Initialize the settings configuration.
  *
@@ -151,6 +425,10 @@ typedef struct {
  *
  * If some of the parameters given are invalid, the program will assert.
  *
+ * The default entries are copied, so the array can be released after the
+ * call. The RAM used is one SettingsConfigEntry per default entry, plus their
+ * default values packed one after the other, no matter the flash size.
+ *
  * @param defaultEntries Pointer to the array of default configuration entries.
  * @param defaultNumEntries Number of default configuration entries.
  * @param flash_offset Offset in flash memory where settings are stored.
@@ -165,17 +443,73 @@ int settings_init(const SettingsConfigEntry *defaultEntries,
                   const uint32_t flashSize, const uint16_t magic,
                   const uint16_t version);
 
+/**
+ * @brief Set the persistence policies of the keys.
+ *
+ * Can be called before or after settings_init(). The table is not copied, so
+ * it must remain valid while the settings manager is in use. Usually it is a
+ * const table next to the default entries:
+ *
+ * static const SettingsKeyPolicy policies[] = {
+ *     {"SESSION_ID", SETTINGS_POLICY_VOLATILE},
+ *     {"SERIAL", SETTINGS_POLICY_WRITE_ONCE}};
+ * settings_set_policies(policies, sizeof(policies) / sizeof(policies[0]));
+ *
+ * Volatile keys found in flash, saved by a previous firmware, get their
+ * default value. Write-once keys found in flash with a value other than their
+ * default one are read-only from then on. While a write-once key keeps its
+ * default value, it can be written and saved.
+ *
+ * @param policies Pointer to the table of policies, or NULL to clear it.
+ * @param numPolicies Number of policies in the table.
+ * @return int 0 on success, non-zero if some policy is not valid or, once
+ * initialized, refers to an unknown key.
+ */
+int settings_set_policies(const SettingsKeyPolicy *policies,
+                          size_t numPolicies);
+
 /**
  * @brief Save the current configuration settings to flash.
  *
- * Saves all configuration entries as a batch. This should be used only in
+ * Saves all configuration entries as a batch, except the volatile ones.
+ * Write-once entries become read-only once saved with a value other than
+ * their default one. This should be used only in
  * configuration mode. Try to avoid calling this function very often, as it
  * will wear out the flash memory.
  *
- * @return int 0 on success, non-zero on failure.
+ * @return int 0 on success, non-zero if the storage failed. Storages that
+ * support it keep the previous image.
  */
 int settings_save();
 
+/**
+ * @brief Status of a save still running, returned by settings_save_step().
+ */
+#define SETTINGS_SAVE_IN_PROGRESS 1
+
+/**
+ * @brief Start a save that runs in steps.
+ *
+ * Writes the same image as settings_save(), but nothing is written until
+ * settings_save_step() is called. Each step erases one sector or programs one
+ * page of the flash, or writes one page or record of other storages, so the
+ * caller can serve other tasks between steps, for example from a cooperative
+ * event loop. Do not change, reload or erase the settings until the save is
+ * complete.
+ *
+ * @return int 0 on success, non-zero if a save is running, the settings do
+ * not fit or the storage failed.
+ */
+int settings_save_begin();
+
+/**
+ * @brief Run the next step of the save started by settings_save_begin().
+ *
+ * @return int SETTINGS_SAVE_IN_PROGRESS while there are steps left, 0 once the
+ * save is complete, negative if there is no save running or it failed.
+ */
+int settings_save_step();
+
 /**
  * @brief Reset the configuration to default values.
  *
@@ -187,17 +521,149 @@ int settings_save();
  */
 int settings_erase();
 
+/**
+ * @brief Reload the settings that changed in flash.
+ *
+ * Picks up changes made to the settings region by someone else, like picotool
+ * or the other core, without calling settings_init() again. The CRC of every
+ * flash sector is compared with the one of the last load or save, and only the
+ * entries stored in sectors that changed are parsed again. Entries are updated
+ * in place and the change callback is invoked for each one that changed.
+ * Entries no longer present in flash get their default value back.
+ *
+ * Changes made in RAM and not saved are kept, unless the entry is stored in a
+ * sector that changed.
+ *
+ * @return int Number of entries that changed, or negative on failure.
+ */
+int settings_reload();
+
+/**
+ * @brief Set the callback invoked when an entry changes.
+ *
+ * @param callback Function to call, or NULL to disable notifications.
+ * @param ctx User context passed to the callback.
+ */
+void settings_set_change_callback(SettingsChangeFn callback, void *ctx);
+
+/**
+ * @brief Restore the default values without erasing the flash.
+ *
+ * Fast factory reset: every entry gets its default value back in RAM, and the
+ * settings stored in flash are invalidated by programming to zero the first
+ * bytes of the magic entry, which needs no erase. The settings manager can be
+ * used right away, without calling settings_init() again. The region is erased
+ * by the next settings_save().
+ *
+ * Write-once entries keep their value in RAM and are stored again by the next
+ * settings_save().
+ *
+ * @return int 0 on success, non-zero on failure.
+ */
+int settings_reset_to_defaults();
+
+/**
+ * @brief Get the statistics of the settings manager.
+ *
+ * @param stats Structure to fill.
+ */
+void settings_get_stats(SettingsStats *stats);
+
 /**
  * @brief Print the current configuration in a tabular format.
+ *
+ * The entries are sorted by key.
  */
 void settings_print();
 
+/**
+ * @brief Start iterating the entries whose key starts with a prefix.
+ *
+ * The entries are kept in an index sorted by key, so the range of a prefix is
+ * found with two binary searches and each entry is returned in constant time.
+ * With hierarchical names like NET_IP and NET_MASK, the prefix "NET_" returns
+ * the whole group:
+ *
+ * SettingsIterator iter;
+ * settings_iter_begin(&iter, "NET_");
+ * SettingsConfigEntry *entry;
+ * while ((entry = settings_iter_next(&iter)) != NULL) {
+ *     // Use entry->key, entry->value and entry->dataType
+ * }
+ *
+ * The internal magic/version entry is never returned.
+ *
+ * @param iter Iterator to initialize.
+ * @param prefix Prefix of the keys, or NULL or "" for all the entries.
+ * @return size_t Number of entries that will be returned.
+ */
+size_t settings_iter_begin(SettingsIterator *iter, const char *prefix);
+
+/**
+ * @brief Get the next entry of an iterator, in key order.
+ *
+ * As with settings_find_entry(), prefer the settings_put_ functions to
+ * change the entry.
+ *
+ * @param iter Iterator started with settings_iter_begin().
+ * @return SettingsConfigEntry* The next entry, or NULL at the end.
+ */
+SettingsConfigEntry *settings_iter_next(SettingsIterator *iter);
+
+/**
+ * @brief Return only some of the entries of an iterator.
+ *
+ * Call it after settings_iter_begin(), whose count does not include the
+ * filter. It also applies to settings_iter_next().
+ *
+ * @param iter Iterator started with settings_iter_begin().
+ * @param filter SettingsFilter flags combined with |.
+ */
+void settings_iter_filter(SettingsIterator *iter, uint8_t filter);
+
+/**
+ * @brief Read a copy of the next entry of an iterator, in key order.
+ *
+ * Unlike settings_iter_next(), the entries in RAM are not exposed: the key,
+ * the type and the typed value are copied to info. A web page or a telemetry
+ * frame is built in one pass, without a lookup per key:
+ *
+ * SettingsIterator iter;
+ * SettingsEntryInfo info;
+ * settings_iter_begin(&iter, "NET_");
+ * settings_iter_filter(&iter, SETTINGS_FILTER_DIRTY);
+ * while (settings_iter_read(&iter, &info)) {
+ *     // Use info.key, info.dataType, info.intValue, ...
+ * }
+ *
+ * @param iter Iterator started with settings_iter_begin().
+ * @param info Copy of the entry.
+ * @return bool true if an entry was read, false at the end.
+ */
+bool settings_iter_read(SettingsIterator *iter, SettingsEntryInfo *info);
+
+/**
+ * @brief Invoke a callback for each entry, in key order.
+ *
+ * @param prefix Prefix of the keys, or NULL or "" for all the entries.
+ * @param filter SettingsFilter flags combined with |.
+ * @param visit Callback invoked for each entry.
+ * @param ctx User context passed to the callback.
+ * @return int 0 after all the entries, or the non-zero value returned by the
+ * callback to stop.
+ */
+int settings_foreach(const char *prefix, uint8_t filter, SettingsVisitFn visit,
+                     void *ctx);
+
 /**
  * @brief Find a configuration entry by its key.
  *
- * If they key is not found, it returns NULL.
+ * If they key is not found, it returns NULL. The key is found with a binary
+ * search in the index of keys.
  * If the key is found, it returns a pointer to the SettingsConfigEntry
- * structure. To access the value, use the value field.
+ * structure. To access the value, use the value field. A value changed through
+ * the pointer is saved by settings_save(), but the entry is not marked dirty
+ * and the change callback is not invoked: prefer the settings_put_ functions.
  *
  * Example:
  * SettingsConfigEntry* entry = settings_find_entry("desired_key");
@@ -216,7 +682,8 @@ SettingsConfigEntry *settings_find_entry(const char *key);
 /**
  * @brief Update a boolean configuration entry.
  *
- * Update the value of a boolean configuration entry by its key.
+ * Update the value of a boolean configuration entry by its key. Fails for
+ * write-once entries already saved, as all the settings_put_* functions.
  *
  * @param key The key of the entry.
  * @param value The boolean value to set.
@@ -247,4 +714,172 @@ int settings_put_string(const char key[SETTINGS_MAX_KEY_LENGTH],
  */
 int settings_put_integer(const char key[SETTINGS_MAX_KEY_LENGTH], int value);
 
+/**
+ * @brief State of a streaming import.
+ *
+ * The importer is a push parser: the caller feeds the document in chunks of
+ * any size and every key-value pair is applied to the configuration as soon as
+ * it is complete. The structure is owned by the caller and its members are
+ * private except applied and skipped.
+ */
+typedef struct {
+  SettingsStreamFormat format; ///< Format of the document being imported
+  int state;                   ///< Parser state (private)
+  int subState;                ///< Parser sub-state (private)
+  uint8_t major;               ///< CBOR header major type (private)
+  uint8_t need;                ///< CBOR header bytes pending (private)
+  uint64_t arg;                ///< CBOR argument or JSON escape (private)
+  uint64_t remaining;          ///< Bytes pending in current item (private)
+  uint64_t pairs;              ///< Pairs pending in a CBOR map (private)
+  bool indefinite;             ///< CBOR map of indefinite length (private)
+  bool overflow;               ///< Current key or value too long (private)
+  size_t keyLen;               ///< Length of the key being parsed (private)
+  size_t valueLen;             ///< Length of the value being parsed (private)
+  char key[SETTINGS_MAX_KEY_LENGTH];     ///< Key being parsed (private)
+  char value[SETTINGS_MAX_VALUE_LENGTH]; ///< Value being parsed (private)
+  uint16_t applied; ///< Number of entries applied to the configuration
+  uint16_t skipped; ///< Number of entries skipped (unknown or invalid)
+} SettingsImportContext;
+
+/**
+ * @brief Export the configuration as a stream.
+ *
+ * Writes every entry except the internal magic/version entry to the sink in
+ * chunks of at most SETTINGS_STREAM_CHUNK_SIZE bytes. Integer and boolean
+ * entries are exported with their native JSON or CBOR types, strings as text.
+ * Works in release builds, unlike settings_print().
+ *
+ * @param format Output format.
+ * @param sink Callback receiving the chunks.
+ * @param ctx User context passed to the sink.
+ * @return int 0 on success, non-zero if the sink aborted the export.
+ */
+int settings_export(SettingsStreamFormat format, SettingsSinkFn sink,
+                    void *ctx);
+
+/**
+ * @brief Get the generation of the settings.
+ *
+ * The generation is stored with the magic value and increases every time the
+ * settings are saved to flash. It identifies the persisted state of the store
+ * and is used as the base version of delta patches.
+ *
+ * @return uint32_t The generation of the last saved or loaded settings.
+ */
+uint32_t settings_get_generation();
+
+/**
+ * @brief Create a binary delta patch from a base image to the current state.
+ *
+ * Compares the entries of a base image, in the same format the settings are
+ * stored in flash, with the current configuration in RAM and writes a patch
+ * with the entries that changed to the sink. Entries equal to their default
+ * value are encoded as SETTINGS_DELTA_OP_DEFAULT records, without value.
+ *
+ * @param baseImage Pointer to the base image, or NULL to use the settings
+ * currently stored in flash.
+ * @param baseSize Size of the base image in bytes. Ignored if baseImage is
+ * NULL.
+ * @param sink Callback receiving the patch in chunks.
+ * @param ctx User context passed to the sink.
+ * @return int Number of records in the patch, or negative on failure.
+ */
+int settings_delta_create(const uint8_t *baseImage, size_t baseSize,
+                          SettingsSinkFn sink, void *ctx);
+
+/**
+ * @brief Apply a binary delta patch and save the settings.
+ *
+ * The whole patch is validated before changing anything: the CRC, the magic
+ * value of the store, the base generation and every key and type. If any check
+ * fails the configuration is left untouched. Otherwise all the records are
+ * applied and the settings are saved to flash once.
+ *
+ * @param patch Pointer to the patch.
+ * @param len Length of the patch in bytes.
+ * @return int 0 on success, or one of the SETTINGS_DELTA_ERR_* codes.
+ */
+int settings_delta_apply(const uint8_t *patch, size_t len);
+
+/**
+ * @brief Compute the CRC32 (IEEE 802.3) of a buffer.
+ *
+ * The CRC can be computed in several steps, passing the result of the previous
+ * call as crc. Use 0 for the first call.
+ *
+ * @param crc CRC of the previous data, or 0.
+ * @param data Pointer to the data.
+ * @param len Number of bytes.
+ * @return uint32_t The updated CRC.
+ */
+uint32_t settings_crc32(uint32_t crc, const void *data, size_t len);
+
+/**
+ * @brief Start a streaming import.
+ *
+ * @param importCtx Import state to initialize.
+ * @param format Format of the document to import.
+ * @return int 0 on success, non-zero on failure.
+ */
+int settings_import_begin(SettingsImportContext *importCtx,
+                          SettingsStreamFormat format);
+
+/**
+ * @brief Feed a chunk of the document to a streaming import.
+ *
+ * Entries are applied to the configuration in RAM as soon as they are parsed,
+ * converted to the type of the default value of their key. Unknown keys,
+ * values too long for an entry and values that cannot be converted are
+ * skipped and counted, but do not stop the import. Nothing is written to
+ * flash: call settings_save() once the import has finished.
+ *
+ * @param importCtx Import state.
+ * @param data Chunk of the document.
+ * @param len Number of bytes in the chunk.
+ * @return int 0 on success, non-zero if the document is malformed.
+ */
+int settings_import_feed(SettingsImportContext *importCtx, const uint8_t *data,
+                         size_t len);
+
+/**
+ * @brief Finish a streaming import.
+ *
+ * @param importCtx Import state.
+ * @return int 0 if the whole document was parsed, non-zero if it is truncated
+ * or malformed.
+ */
+int settings_import_end(SettingsImportContext *importCtx);
+
+/**
+ * @brief Load settings from an INI or KEY=VALUE file.
+ *
+ * The file is read in chunks of SETTINGS_STREAM_CHUNK_SIZE bytes and parsed
+ * as it arrives, so the memory used does not depend on its size. Every line
+ * is one of:
+ *
+ * - KEY=VALUE. Spaces around the key and the value are ignored, and a value
+ *   between double quotes is taken without them.
+ * - [SECTION]. The following keys are prefixed with the section name and
+ *   SETTINGS_INI_SECTION_SEPARATOR. An empty section "[]" removes the prefix.
+ * - A comment starting with ';' or '#', or an empty line.
+ *
+ * Values are converted to the type of the key in the default entries. Lines
+ * with unknown keys, values of the wrong type or too long, and write-once
+ * keys already saved are reported to the error callback and skipped. The
+ * other lines are applied to the configuration in RAM: call settings_save()
+ * to persist them.
+ *
+ * @param readFn Callback reading the file.
+ * @param errorFn Callback receiving the errors, or NULL.
+ * @param ctx User context passed to both callbacks.
+ * @return int Number of lines skipped because of errors, or -1 if the read
+ * callback failed.
+ */
+int settings_load_ini(SettingsReadFn readFn, SettingsIniErrorFn errorFn,
+                      void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif // SETTINGS_H
@@ -0,0 +1,153 @@
+/**
+ * @file settings.hpp
+ * @author Diego Parrilla
+ * @date October 2026
+ * @copyright 2026 - GOODDATA LABS SL
+ *
+ * @brief C++20 coroutine interface of the settings manager, for firmware
+ * built around a cooperative event loop.
+ *
+ * co_await on a save runs it with settings_save_begin() and
+ * settings_save_step(): the coroutine is suspended after each sector erase or
+ * page program, and the event loop serves its other tasks before the next
+ * one. The coroutine is resumed once the save is complete.
+ */
+
+#ifndef SETTINGS_HPP
+#define SETTINGS_HPP
+
+#include <coroutine>
+
+#include "settings.h"
+#include "settings_flash.h"
+
+namespace settings {
+
+/**
+ * @brief Event loop that runs the steps of the awaited operations.
+ *
+ * post() queues a function to be called later from the loop, never from
+ * inside post(). Each call runs one step, at most one sector erase or page
+ * program, and posts the next one.
+ */
+class Executor {
+ public:
+  virtual void post(void (*fn)(void *ctx), void *ctx) = 0;
+
+ protected:
+  ~Executor() = default;
+};
+
+/**
+ * @brief Awaitable running an operation one step at a time from the executor.
+ *
+ * The result of co_await is 0 on success or non-zero on error, as in the C
+ * interface.
+ */
+class StepAwaiter {
+ public:
+  void await_suspend(std::coroutine_handle<> handle) noexcept {
+    handle_ = handle;
+    executor_.post(&StepAwaiter::runStep, this);
+  }
+
+  int await_resume() const noexcept { return status_; }
+
+ protected:
+  StepAwaiter(Executor &executor, int (*step)())
+      : executor_(executor), step_(step) {}
+
+  int status_ = 0;
+
+ private:
+  static void runStep(void *ctx) {
+    StepAwaiter *self = static_cast<StepAwaiter *>(ctx);
+    self->status_ = self->step_();
+    if (self->status_ == SETTINGS_SAVE_IN_PROGRESS) {
+      self->executor_.post(&StepAwaiter::runStep, self);
+      return;
+    }
+    // The awaiter is gone once the coroutine runs again
+    self->handle_.resume();
+  }
+
+  Executor &executor_;
+  int (*step_)();
+  std::coroutine_handle<> handle_;
+};
+
+/**
+ * @brief Awaitable save of the settings. See settings_save_begin().
+ *
+ * The save starts when the coroutine is suspended by co_await, not when the
+ * awaiter is created.
+ */
+class SaveAwaiter : public StepAwaiter {
+ public:
+  explicit SaveAwaiter(Executor &executor)
+      : StepAwaiter(executor, settings_save_step) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  // A save that cannot start resumes the coroutine right away
+  bool await_suspend(std::coroutine_handle<> handle) noexcept {
+    status_ = settings_save_begin();
+    if (status_ != 0) {
+      return false;
+    }
+    StepAwaiter::await_suspend(handle);
+    return true;
+  }
+};
+
+/**
+ * @brief Awaitable run of the queue of the flash scheduler, like
+ * settings_flash_flush(), including the operations of other writers.
+ */
+class FlushAwaiter : public StepAwaiter {
+ public:
+  explicit FlushAwaiter(Executor &executor)
+      : StepAwaiter(executor, flushStep) {}
+
+  bool await_ready() noexcept { return flushDone(); }
+
+ private:
+  static bool flushDone() {
+    SettingsFlashStats stats;
+    settings_flash_get_stats(&stats);
+    return stats.queued == 0;
+  }
+
+  static int flushStep() {
+    settings_flash_step();
+    return flushDone() ? 0 : SETTINGS_SAVE_IN_PROGRESS;
+  }
+};
+
+/**
+ * @brief Awaitable operations of the settings, run by an executor.
+ *
+ * Usage, from a coroutine of the event loop:
+ *
+ *   settings::Settings store(loop);
+ *   ...
+ *   settings_put_integer("BOOT_DELAY", 5);
+ *   int err = co_await store.save();
+ */
+class Settings {
+ public:
+  explicit Settings(Executor &executor) : executor_(executor) {}
+
+  /// Save the settings, one step per turn of the event loop.
+  SaveAwaiter save() { return SaveAwaiter(executor_); }
+
+  /// Run the queued flash operations, one step per turn of the event loop.
+  FlushAwaiter flush() { return FlushAwaiter(executor_); }
+
+ private:
+  Executor &executor_;
+};
+
+} // namespace settings
+
+#endif // SETTINGS_HPP
@@ -0,0 +1,161 @@
+#include "settings_fatfs.h"
+
+static bool fatfsExists(const char *path) {
+  FILINFO info;
+  return f_stat(path, &info) == FR_OK;
+}
+
+static int fatfsRemove(const char *path) {
+  FRESULT result = f_unlink(path);
+  return result == FR_OK || result == FR_NO_FILE ? 0 : -1;
+}
+
+static void fatfsClose(SettingsFatfsStorage *storage) {
+  if (storage->reading || storage->writing) {
+    f_close(&storage->file);
+  }
+  storage->reading = false;
+  storage->writing = false;
+}
+
+static int fatfsRead(uint32_t offset, void *buffer, size_t len, void *ctx) {
+  SettingsFatfsStorage *storage = (SettingsFatfsStorage *)ctx;
+  memset(buffer, 0, len);  // Past the end of the file, or no file at all
+  // A read of the start begins a new pass over the file, like the ones of
+  // settings_init() and settings_reload(). Open it again, so a file replaced
+  // or created by another writer since the last pass is seen
+  if (offset == 0 && !storage->writing) {
+    fatfsClose(storage);
+    storage->missing = !fatfsExists(storage->path);
+  }
+  if (storage->missing) {
+    return 0;
+  }
+  if (!storage->reading) {
+    FRESULT result = f_open(&storage->file, storage->path, FA_READ);
+    if (result == FR_NO_FILE || result == FR_NO_PATH) {
+      storage->missing = true;
+      return 0;
+    }
+    if (result != FR_OK) {
+      DPRINTF("Cannot open %s: %d\n", storage->path, result);
+      return -1;
+    }
+    storage->reading = true;
+  }
+  if (offset >= f_size(&storage->file)) {
+    return 0;
+  }
+  UINT read = 0;
+  if (f_lseek(&storage->file, offset) != FR_OK ||
+      f_read(&storage->file, buffer, len, &read) != FR_OK) {
+    fatfsClose(storage);
+    return -1;
+  }
+  return 0;
+}
+
+static int fatfsBegin(void *ctx) {
+  SettingsFatfsStorage *storage = (SettingsFatfsStorage *)ctx;
+  fatfsClose(storage);
+  FRESULT result = f_open(&storage->file, storage->tempPath,
+                          FA_CREATE_ALWAYS | FA_WRITE);
+  if (result != FR_OK) {
+    DPRINTF("Cannot create %s: %d\n", storage->tempPath, result);
+    return -1;
+  }
+  storage->writing = true;
+  return 0;
+}
+
+static int fatfsWrite(uint32_t offset, const void *data, size_t len,
+                      void *ctx) {
+  SettingsFatfsStorage *storage = (SettingsFatfsStorage *)ctx;
+  UINT written = 0;
+  if (f_lseek(&storage->file, offset) != FR_OK ||
+      f_write(&storage->file, data, len, &written) != FR_OK ||
+      written != len) {
+    DPRINTF("Cannot write %s at offset %lu\n", storage->tempPath, offset);
+    return -1;
+  }
+  return 0;
+}
+
+static int fatfsEnd(bool commit, void *ctx) {
+  SettingsFatfsStorage *storage = (SettingsFatfsStorage *)ctx;
+  FRESULT result = f_close(&storage->file);
+  storage->writing = false;
+  if (!commit || result != FR_OK) {
+    fatfsRemove(storage->tempPath);
+    return commit ? -1 : 0;
+  }
+
+  // The backup only exists while the temporary file is complete
+  if (fatfsRemove(storage->backupPath) != 0) {
+    return -1;
+  }
+  if (!storage->missing) {
+    result = f_rename(storage->path, storage->backupPath);
+    if (result != FR_OK && result != FR_NO_FILE) {
+      return -1;
+    }
+  }
+  if (f_rename(storage->tempPath, storage->path) != FR_OK) {
+    return -1;
+  }
+  storage->missing = false;
+  fatfsRemove(storage->backupPath);
+  return 0;
+}
+
+static int fatfsErase(void *ctx) {
+  SettingsFatfsStorage *storage = (SettingsFatfsStorage *)ctx;
+  fatfsClose(storage);
+  int error = fatfsRemove(storage->path);
+  fatfsRemove(storage->tempPath);
+  fatfsRemove(storage->backupPath);
+  storage->missing = true;
+  return error;
+}
+
+const SettingsStorageOps settings_fatfs_ops = {.read = fatfsRead,
+                                               .begin = fatfsBegin,
+                                               .write = fatfsWrite,
+                                               .end = fatfsEnd,
+                                               .erase = fatfsErase};
+
+int settings_fatfs_init(SettingsFatfsStorage *storage, const char *path) {
+  if (storage == NULL || path == NULL ||
+      strlen(path) >= SETTINGS_FATFS_MAX_PATH) {
+    return -1;
+  }
+  memset(storage, 0, sizeof(SettingsFatfsStorage));
+  strcpy(storage->path, path);
+  snprintf(storage->tempPath, sizeof(storage->tempPath), "%s%s", path,
+           SETTINGS_FATFS_TEMP_SUFFIX);
+  snprintf(storage->backupPath, sizeof(storage->backupPath), "%s%s", path,
+           SETTINGS_FATFS_BACKUP_SUFFIX);
+
+  // Finish or roll back a replace interrupted by a reset
+  bool backup = fatfsExists(storage->backupPath);
+  if (!fatfsExists(storage->path)) {
+    if (backup && fatfsExists(storage->tempPath)) {
+      DPRINTF("Completing the replace of %s\n", path);
+      if (f_rename(storage->tempPath, storage->path) != FR_OK) {
+        return -1;
+      }
+    } else if (backup) {
+      DPRINTF("Restoring %s from its backup\n", path);
+      if (f_rename(storage->backupPath, storage->path) != FR_OK) {
+        return -1;
+      }
+    }
+  }
+  // A temporary file left alone was not completely written
+  if (fatfsRemove(storage->tempPath) != 0 ||
+      fatfsRemove(storage->backupPath) != 0) {
+    return -1;
+  }
+  storage->missing = !fatfsExists(storage->path);
+  return 0;
+}
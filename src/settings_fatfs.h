@@ -0,0 +1,76 @@
+/**
+ * @file settings_fatfs.h
+ * @author Diego Parrilla
+ * @date October 2026
+ * @copyright 2026 - GOODDATA LABS SL
+ *
+ * @brief Storage of the settings in a file of a FatFs volume, for example an
+ * SD card. Optional: build settings_fatfs.c with the FatFs library.
+ */
+
+#ifndef SETTINGS_FATFS_H
+#define SETTINGS_FATFS_H
+
+#include "ff.h"
+#include "settings.h"
+
+/**
+ * @brief Maximum length of the path of the settings file.
+ */
+#define SETTINGS_FATFS_MAX_PATH 64
+
+/**
+ * @brief Suffixes of the files used to replace the settings file.
+ *
+ * A save writes the new image to the temporary file, renames the settings
+ * file to the backup file, renames the temporary file to the settings file
+ * and removes the backup file. FatFs cannot rename over an existing file, so
+ * this is the closest to an atomic replace. settings_fatfs_init() completes
+ * or rolls back a replace interrupted by a reset or a power loss.
+ */
+#define SETTINGS_FATFS_TEMP_SUFFIX ".tmp"
+#define SETTINGS_FATFS_BACKUP_SUFFIX ".bak"
+
+/**
+ * @brief State of the FatFs storage. Its members are private.
+ */
+typedef struct {
+  char path[SETTINGS_FATFS_MAX_PATH];
+  char tempPath[SETTINGS_FATFS_MAX_PATH + sizeof(SETTINGS_FATFS_TEMP_SUFFIX)];
+  char backupPath[SETTINGS_FATFS_MAX_PATH +
+                  sizeof(SETTINGS_FATFS_BACKUP_SUFFIX)];
+  FIL file;       ///< Settings file while reading, temporary while writing
+  bool reading;   ///< The settings file is open
+  bool writing;   ///< The temporary file is open
+  bool missing;   ///< There is no settings file yet
+} SettingsFatfsStorage;
+
+/**
+ * @brief Operations of the FatFs storage, for settings_set_storage().
+ */
+extern const SettingsStorageOps settings_fatfs_ops;
+
+/**
+ * @brief Initialize the FatFs storage.
+ *
+ * The volume must be mounted. Recovers from a save interrupted while
+ * replacing the file. Then select the storage before settings_init():
+ *
+ * static SettingsFatfsStorage storage;
+ * settings_fatfs_init(&storage, "0:/settings.bin");
+ * settings_set_storage(&settings_fatfs_ops, &storage);
+ *
+ * The settings are read from the file only by settings_init(),
+ * settings_reload() and settings_delta_create(). Each of them opens the file
+ * again, so they see a file replaced or created by another writer. The rest
+ * of the functions work with the copy in RAM, and settings_save() writes it
+ * back.
+ *
+ * @param storage State of the storage. Must remain valid while in use.
+ * @param path Path of the settings file.
+ * @return int 0 on success, non-zero if the path is too long or the volume
+ * cannot be accessed.
+ */
+int settings_fatfs_init(SettingsFatfsStorage *storage, const char *path);
+
+#endif // SETTINGS_FATFS_H
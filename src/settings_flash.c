@@ -0,0 +1,206 @@
+#include "settings_flash.h"
+
+#include <hardware/flash.h>
+#include <hardware/sync.h>
+#include <pico/time.h>
+
+#include "settings.h"
+
+// Queue sorted by priority, deadline and order of arrival
+static SettingsFlashOp *queueHead = NULL;
+static uint16_t queueLength = 0;
+
+static uint32_t maxWindowUs = 0;
+// Duration of the last sector erase and page program, to plan the windows and
+// start the operations before their deadline. Typical ones until measured
+static uint32_t eraseStepUs = SETTINGS_FLASH_ERASE_STEP_US;
+static uint32_t programStepUs = SETTINGS_FLASH_PROGRAM_STEP_US;
+
+static SettingsFlashStats flashStats = {0};
+
+static uint32_t defaultLockEnter(void *ctx) {
+  return save_and_disable_interrupts();
+}
+
+static void defaultLockExit(uint32_t state, void *ctx) {
+  restore_interrupts(state);
+}
+
+static const SettingsFlashLockOps defaultLockOps = {.enter = defaultLockEnter,
+                                                    .exit = defaultLockExit};
+
+static const SettingsFlashLockOps *lockOps = &defaultLockOps;
+static void *lockCtx = NULL;
+
+void settings_flash_set_lock(const SettingsFlashLockOps *ops, void *ctx) {
+  lockOps = ops != NULL ? ops : &defaultLockOps;
+  lockCtx = ops != NULL ? ctx : NULL;
+}
+
+void settings_flash_set_max_window(uint32_t maxUs) { maxWindowUs = maxUs; }
+
+// Operations without a deadline go after the ones with a deadline
+static uint64_t opDeadline(const SettingsFlashOp *op) {
+  return op->deadlineUs != 0 ? op->deadlineUs : UINT64_MAX;
+}
+
+static bool opRunsBefore(const SettingsFlashOp *op,
+                         const SettingsFlashOp *other) {
+  if (op->priority != other->priority) {
+    return op->priority > other->priority;
+  }
+  return opDeadline(op) < opDeadline(other);
+}
+
+int settings_flash_submit(SettingsFlashOp *op) {
+  size_t align =
+      op->type == SETTINGS_FLASH_ERASE ? FLASH_SECTOR_SIZE : FLASH_PAGE_SIZE;
+  if (op->status == SETTINGS_FLASH_PENDING || op->count == 0 ||
+      op->offset % align != 0 || op->count % align != 0 ||
+      (op->type == SETTINGS_FLASH_PROGRAM && op->data == NULL) ||
+      (op->type != SETTINGS_FLASH_ERASE &&
+       op->type != SETTINGS_FLASH_PROGRAM)) {
+    DPRINTF("Invalid flash operation at offset %lx.\n", op->offset);
+    return -1;
+  }
+#ifdef PICO_FLASH_SIZE_BYTES
+  if (op->offset + op->count > PICO_FLASH_SIZE_BYTES) {
+    DPRINTF("Flash operation at offset %lx out of range.\n", op->offset);
+    return -1;
+  }
+#endif
+  op->status = SETTINGS_FLASH_PENDING;
+  op->progress = 0;
+
+  SettingsFlashOp **link = &queueHead;
+  while (*link != NULL && !opRunsBefore(op, *link)) {
+    link = &(*link)->next;
+  }
+  op->next = *link;
+  *link = op;
+  queueLength++;
+  return 0;
+}
+
+// Erase a sector or program a page of the first operation of the queue.
+// Returns the operation if it is complete
+static SettingsFlashOp *runStep() {
+  SettingsFlashOp *op = queueHead;
+  uint64_t startUs = time_us_64();
+  if (op->type == SETTINGS_FLASH_ERASE) {
+    flash_range_erase(op->offset + op->progress, FLASH_SECTOR_SIZE);
+    op->progress += FLASH_SECTOR_SIZE;
+    eraseStepUs = (uint32_t)(time_us_64() - startUs);
+  } else {
+    flash_range_program(op->offset + op->progress, op->data + op->progress,
+                        FLASH_PAGE_SIZE);
+    op->progress += FLASH_PAGE_SIZE;
+    programStepUs = (uint32_t)(time_us_64() - startUs);
+  }
+  if (op->progress < op->count) {
+    return NULL;
+  }
+  queueHead = op->next;
+  queueLength--;
+  op->next = NULL;
+  op->status = 0;
+  return op;
+}
+
+static bool stepFitsWindow(uint32_t elapsedUs) {
+  if (maxWindowUs == 0) {
+    return true;
+  }
+  uint32_t stepUs =
+      queueHead->type == SETTINGS_FLASH_ERASE ? eraseStepUs : programStepUs;
+  return elapsedUs + stepUs <= maxWindowUs;
+}
+
+// Run one lockout window, of a single step if singleStep is set. The callbacks
+// of the completed operations are invoked once it is over. Returns the number
+// of completed operations
+static int runWindow(const SettingsFlashOp *until, bool singleStep) {
+  SettingsFlashOp *completed = NULL;
+  SettingsFlashOp **tail = &completed;
+  int numCompleted = 0;
+
+  uint32_t state = lockOps->enter(lockCtx);
+  uint64_t startUs = time_us_64();
+  do {
+    SettingsFlashOp *op = runStep();
+    if (op != NULL) {
+      *tail = op;
+      tail = &op->next;
+      numCompleted++;
+      if (op == until) {
+        break;
+      }
+    }
+  } while (!singleStep && queueHead != NULL &&
+           stepFitsWindow((uint32_t)(time_us_64() - startUs)));
+  uint32_t windowUs = (uint32_t)(time_us_64() - startUs);
+  lockOps->exit(state, lockCtx);
+
+  flashStats.operations += numCompleted;
+  flashStats.windows++;
+  flashStats.lockedUs += windowUs;
+  if (windowUs > flashStats.maxWindowUs) {
+    flashStats.maxWindowUs = windowUs;
+  }
+
+  while (completed != NULL) {
+    SettingsFlashOp *op = completed;
+    completed = op->next;
+    op->next = NULL;
+    if (op->done != NULL) {
+      op->done(op, op->ctx);
+    }
+  }
+  return numCompleted;
+}
+
+int settings_flash_flush() {
+  int numCompleted = 0;
+  while (queueHead != NULL) {
+    numCompleted += runWindow(NULL, false);
+  }
+  return numCompleted;
+}
+
+// Estimated duration of the steps left of an operation
+static uint64_t opRemainingUs(const SettingsFlashOp *op) {
+  if (op->type == SETTINGS_FLASH_ERASE) {
+    return (uint64_t)((op->count - op->progress) / FLASH_SECTOR_SIZE) *
+           eraseStepUs;
+  }
+  return (uint64_t)((op->count - op->progress) / FLASH_PAGE_SIZE) *
+         programStepUs;
+}
+
+int settings_flash_poll() {
+  // The queue runs in order, so an operation ends after the ones before it
+  uint64_t endUs = time_us_64();
+  for (const SettingsFlashOp *op = queueHead; op != NULL; op = op->next) {
+    endUs += opRemainingUs(op);
+    if (op->deadlineUs == 0 || endUs >= op->deadlineUs) {
+      return settings_flash_flush();
+    }
+  }
+  return 0;
+}
+
+int settings_flash_wait(SettingsFlashOp *op) {
+  while (op->status == SETTINGS_FLASH_PENDING && queueHead != NULL) {
+    runWindow(op, false);
+  }
+  return op->status;
+}
+
+int settings_flash_step() {
+  return queueHead != NULL ? runWindow(NULL, true) : 0;
+}
+
+void settings_flash_get_stats(SettingsFlashStats *stats) {
+  *stats = flashStats;
+  stats->queued = queueLength;
+}
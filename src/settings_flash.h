@@ -0,0 +1,206 @@
+/**
+ * @file settings_flash.h
+ * @author Diego Parrilla
+ * @date October 2026
+ * @copyright 2026 - GOODDATA LABS SL
+ *
+ * @brief Scheduler of the erase and program operations of the flash memory,
+ * shared by the settings and any other code writing to the flash, like caches
+ * or logs.
+ *
+ * While the flash is erased or programmed, the code cannot run from it, so the
+ * interrupts are disabled and, with both cores running, the other core must
+ * be locked out. Instead of each writer paying for its own lockout, the
+ * writers queue their operations here. The scheduler runs them in order of
+ * priority and deadline, several in the same lockout window, and splits them
+ * in sectors and pages so each window is bounded.
+ *
+ * The scheduler is not reentrant: queue and run the operations from the same
+ * core, outside interrupt handlers.
+ */
+
+#ifndef SETTINGS_FLASH_H
+#define SETTINGS_FLASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Priority of the operations of the settings.
+ *
+ * A save waits for its own operations, so they go before most of the rest.
+ */
+#define SETTINGS_FLASH_PRIORITY_SETTINGS 192
+
+/**
+ * @brief Typical duration of a sector erase and a page program, in us.
+ *
+ * Used to plan the operations until the first ones are measured.
+ */
+#define SETTINGS_FLASH_ERASE_STEP_US 45000
+#define SETTINGS_FLASH_PROGRAM_STEP_US 800
+
+/**
+ * @brief Status of an operation still in the queue.
+ */
+#define SETTINGS_FLASH_PENDING 1
+
+/**
+ * @brief Types of flash operations.
+ */
+typedef enum {
+  SETTINGS_FLASH_ERASE = 0,  ///< Erase whole sectors (FLASH_SECTOR_SIZE)
+  SETTINGS_FLASH_PROGRAM = 1 ///< Program whole pages (FLASH_PAGE_SIZE)
+} SettingsFlashOpType;
+
+struct SettingsFlashOp;
+
+/**
+ * @brief Callback invoked when an operation is complete.
+ *
+ * It is called once the lockout window is over, so it can run from flash and
+ * queue new operations.
+ *
+ * @param op The operation. Its status is 0 on success.
+ * @param ctx User context of the operation.
+ */
+typedef void (*SettingsFlashDoneFn)(struct SettingsFlashOp *op, void *ctx);
+
+/**
+ * @brief Flash operation.
+ *
+ * Owned by the caller, and must remain valid, together with its data, until
+ * its status is not SETTINGS_FLASH_PENDING. Zero it before setting the public
+ * members: an operation with a pending status is already queued. The members
+ * after ctx are private.
+ */
+typedef struct SettingsFlashOp {
+  SettingsFlashOpType type; ///< Erase or program
+  uint32_t offset;          ///< Offset in flash, aligned to the sector or page
+  size_t count;             ///< Bytes, multiple of the sector or page size
+  const uint8_t *data;      ///< Data to program, count bytes
+  uint8_t priority;         ///< Higher priorities run first
+  uint64_t deadlineUs;      ///< Latest time_us_64() to finish, 0 for none
+  SettingsFlashDoneFn done; ///< Completion callback, or NULL
+  void *ctx;                ///< User context of the callback
+  volatile int status;      ///< SETTINGS_FLASH_PENDING, 0 or negative error
+  size_t progress;          ///< Bytes already erased or programmed
+  struct SettingsFlashOp *next;
+} SettingsFlashOp;
+
+/**
+ * @brief Lockout of the flash memory.
+ *
+ * enter() is called before a window of operations and returns a state for
+ * exit(). By default the interrupts of the core are disabled. With the other
+ * core running, use for example multicore_lockout_start_blocking() and
+ * multicore_lockout_end_blocking() around the interrupts.
+ */
+typedef struct {
+  uint32_t (*enter)(void *ctx);            ///< Start a lockout window
+  void (*exit)(uint32_t state, void *ctx); ///< End the lockout window
+} SettingsFlashLockOps;
+
+/**
+ * @brief Statistics of the scheduler, since the start.
+ */
+typedef struct {
+  uint32_t operations;  ///< Operations completed
+  uint32_t windows;     ///< Lockout windows
+  uint32_t lockedUs;    ///< Total time in lockout windows, in us
+  uint32_t maxWindowUs; ///< Longest lockout window, in us
+  uint16_t queued;      ///< Operations in the queue
+} SettingsFlashStats;
+
+/**
+ * @brief Select how the flash is locked out during the operations.
+ *
+ * @param ops Lockout operations, or NULL for the default one.
+ * @param ctx User context passed to the operations.
+ */
+void settings_flash_set_lock(const SettingsFlashLockOps *ops, void *ctx);
+
+/**
+ * @brief Set the maximum duration of a lockout window.
+ *
+ * A window runs at least one sector erase or page program, and then stops
+ * when the next step would end past this duration. The interrupts are served
+ * between windows. The duration of the steps is measured as they run.
+ *
+ * @param maxUs Maximum duration in us, or 0 for no limit (the default).
+ */
+void settings_flash_set_max_window(uint32_t maxUs);
+
+/**
+ * @brief Queue a flash operation.
+ *
+ * Operations run by priority, then by deadline, then in the order they were
+ * queued. Operations of the same writer with the same priority and deadline,
+ * like an erase followed by the programs, run in order.
+ *
+ * @param op The operation. Its status is SETTINGS_FLASH_PENDING until done.
+ * @return int 0 on success, non-zero if it is not aligned or already queued.
+ */
+int settings_flash_submit(SettingsFlashOp *op);
+
+/**
+ * @brief Run the queued operations that are due.
+ *
+ * Call it periodically, for example from the main loop. If any operation has
+ * no deadline, or would end past its deadline if started after this call, all
+ * the queued operations run together, sharing the lockout windows. Otherwise
+ * nothing runs, so operations with a deadline wait to be batched with others.
+ *
+ * The end of an operation is estimated from the steps left of the operations
+ * up to it in the queue, and the duration of the last sector erase and page
+ * program. Call it more often than the time of a step, so the operations can
+ * start in time.
+ *
+ * @return int Number of operations completed.
+ */
+int settings_flash_poll();
+
+/**
+ * @brief Run all the queued operations now.
+ *
+ * @return int Number of operations completed.
+ */
+int settings_flash_flush();
+
+/**
+ * @brief Run the queue until an operation is complete.
+ *
+ * The operations before it in the queue run first, in the same windows.
+ *
+ * @param op A queued operation.
+ * @return int Status of the operation: 0 on success, non-zero on error.
+ */
+int settings_flash_wait(SettingsFlashOp *op);
+
+/**
+ * @brief Run the next step of the queue: one sector erase or page program.
+ *
+ * The step runs in its own lockout window, so the caller can do other work
+ * between steps, for example from a cooperative event loop.
+ *
+ * @return int Number of operations completed, 0 or 1.
+ */
+int settings_flash_step();
+
+/**
+ * @brief Get the statistics of the scheduler.
+ *
+ * @param stats Structure to fill.
+ */
+void settings_flash_get_stats(SettingsFlashStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SETTINGS_FLASH_H
@@ -0,0 +1,64 @@
+#include "settings_fram.h"
+
+// Memory address of an offset of the image, big endian. False if it does not
+// fit in two bytes
+static bool framAddress(const SettingsFramStorage *fram, uint32_t offset,
+                        uint8_t *out) {
+  uint32_t address = fram->base + offset;
+  if (address > UINT16_MAX) {
+    return false;
+  }
+  out[0] = (uint8_t)(address >> 8);
+  out[1] = (uint8_t)address;
+  return true;
+}
+
+static int framRead(uint32_t offset, void *buffer, size_t len, void *ctx) {
+  const SettingsFramStorage *fram = (const SettingsFramStorage *)ctx;
+  uint8_t address[2];
+  if (!framAddress(fram, offset, address) ||
+      i2c_write_blocking(fram->i2c, fram->address, address, sizeof(address),
+                         true) != (int)sizeof(address) ||
+      i2c_read_blocking(fram->i2c, fram->address, (uint8_t *)buffer, len,
+                        false) != (int)len) {
+    DPRINTF("FRAM read error at offset %lu\n", offset);
+    return -1;
+  }
+  return 0;
+}
+
+static int framWrite(uint32_t offset, const void *data, size_t len,
+                     void *ctx) {
+  const SettingsFramStorage *fram = (const SettingsFramStorage *)ctx;
+  const uint8_t *bytes = (const uint8_t *)data;
+  uint8_t frame[2 + SETTINGS_FRAM_WRITE_CHUNK];
+  // The address and the data go in the same transaction
+  while (len > 0) {
+    size_t chunk =
+        len < SETTINGS_FRAM_WRITE_CHUNK ? len : SETTINGS_FRAM_WRITE_CHUNK;
+    if (!framAddress(fram, offset, frame)) {
+      return -1;
+    }
+    memcpy(frame + 2, bytes, chunk);
+    if (i2c_write_blocking(fram->i2c, fram->address, frame, chunk + 2,
+                           false) != (int)(chunk + 2)) {
+      DPRINTF("FRAM write error at offset %lu\n", offset);
+      return -1;
+    }
+    offset += chunk;
+    bytes += chunk;
+    len -= chunk;
+  }
+  return 0;
+}
+
+static int framErase(void *ctx) {
+  // An empty magic entry is an empty image
+  static const uint8_t emptyRecord[sizeof(SettingsConfigEntry)] = {0};
+  return framWrite(0, emptyRecord, sizeof(emptyRecord), ctx);
+}
+
+const SettingsStorageOps settings_fram_ops = {.read = framRead,
+                                              .write = framWrite,
+                                              .erase = framErase,
+                                              .inPlace = true};
@@ -0,0 +1,49 @@
+/**
+ * @file settings_fram.h
+ * @author Diego Parrilla
+ * @date October 2026
+ * @copyright 2026 - GOODDATA LABS SL
+ *
+ * @brief Storage of the settings in an I2C FRAM, like the MB85RC or FM24
+ * families. Optional: build settings_fram.c and link hardware_i2c.
+ */
+
+#ifndef SETTINGS_FRAM_H
+#define SETTINGS_FRAM_H
+
+#include <hardware/i2c.h>
+
+#include "settings.h"
+
+/**
+ * @brief Bytes of data sent in each I2C write transaction.
+ */
+#define SETTINGS_FRAM_WRITE_CHUNK 32
+
+/**
+ * @brief Configuration of the FRAM storage.
+ *
+ * The FRAM is addressed with two bytes, so up to 64 Kbytes are supported.
+ * The I2C bus must be initialized by the application.
+ */
+typedef struct {
+  i2c_inst_t *i2c;  ///< I2C bus of the FRAM
+  uint8_t address;  ///< 7-bit I2C address of the FRAM, usually 0x50
+  uint16_t base;    ///< Address of the settings image in the FRAM
+} SettingsFramStorage;
+
+/**
+ * @brief Operations of the FRAM storage, for settings_set_storage().
+ *
+ * FRAM has no erase and almost unlimited endurance, so the storage is written
+ * in place: a save only writes the records that changed, taking
+ * microseconds instead of the milliseconds of a flash sector erase. Saving
+ * after every change is fine:
+ *
+ * static SettingsFramStorage fram = {i2c0, 0x50, 0};
+ * settings_set_storage(&settings_fram_ops, &fram);
+ * settings_init(entries, numEntries, 0, 4096, MAGIC_NUMBER, VERSION_NUMBER);
+ */
+extern const SettingsStorageOps settings_fram_ops;
+
+#endif // SETTINGS_FRAM_H
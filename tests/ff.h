@@ -0,0 +1,57 @@
+/**
+ * @file ff.h
+ * @author Diego Parrilla
+ * @date October 2026
+ * @copyright 2026 - GOODDATA LABS SL
+ *
+ * @brief The FatFs calls used by settings_fatfs.c, on the files of the host.
+ *
+ * Paths are relative to the working directory. As with FatFs, f_rename()
+ * fails if the new name exists.
+ */
+
+#ifndef FF_H
+#define FF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef unsigned int UINT;
+typedef uint8_t BYTE;
+typedef uint32_t FSIZE_t;
+
+typedef enum {
+  FR_OK = 0,
+  FR_DISK_ERR,
+  FR_INT_ERR,
+  FR_NOT_READY,
+  FR_NO_FILE,
+  FR_NO_PATH,
+  FR_INVALID_NAME,
+  FR_DENIED,
+  FR_EXIST
+} FRESULT;
+
+#define FA_READ 0x01
+#define FA_WRITE 0x02
+#define FA_CREATE_ALWAYS 0x08
+
+typedef struct {
+  FILE *fp;
+} FIL;
+
+typedef struct {
+  FSIZE_t fsize;
+} FILINFO;
+
+FRESULT f_open(FIL *fp, const char *path, BYTE mode);
+FRESULT f_close(FIL *fp);
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br);
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw);
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs);
+FSIZE_t f_size(FIL *fp);
+FRESULT f_stat(const char *path, FILINFO *fno);
+FRESULT f_unlink(const char *path);
+FRESULT f_rename(const char *path_old, const char *path_new);
+
+#endif // FF_H
@@ -0,0 +1,63 @@
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "ff.h"
+
+static FRESULT errnoResult() {
+  return errno == ENOENT ? FR_NO_FILE : FR_DISK_ERR;
+}
+
+FRESULT f_open(FIL *fp, const char *path, BYTE mode) {
+  const char *fopenMode = (mode & FA_CREATE_ALWAYS) ? "w+b"
+                          : (mode & FA_WRITE)       ? "r+b"
+                                                    : "rb";
+  fp->fp = fopen(path, fopenMode);
+  return fp->fp != NULL ? FR_OK : errnoResult();
+}
+
+FRESULT f_close(FIL *fp) {
+  int result = fclose(fp->fp);
+  fp->fp = NULL;
+  return result == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br) {
+  *br = (UINT)fread(buff, 1, btr, fp->fp);
+  return ferror(fp->fp) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw) {
+  *bw = (UINT)fwrite(buff, 1, btw, fp->fp);
+  return ferror(fp->fp) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs) {
+  return fseek(fp->fp, (long)ofs, SEEK_SET) == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+FSIZE_t f_size(FIL *fp) {
+  struct stat info;
+  fflush(fp->fp);
+  return fstat(fileno(fp->fp), &info) == 0 ? (FSIZE_t)info.st_size : 0;
+}
+
+FRESULT f_stat(const char *path, FILINFO *fno) {
+  struct stat info;
+  if (stat(path, &info) != 0) {
+    return errnoResult();
+  }
+  fno->fsize = (FSIZE_t)info.st_size;
+  return FR_OK;
+}
+
+FRESULT f_unlink(const char *path) {
+  return remove(path) == 0 ? FR_OK : errnoResult();
+}
+
+FRESULT f_rename(const char *path_old, const char *path_new) {
+  struct stat info;
+  if (stat(path_new, &info) == 0) {
+    return FR_EXIST;
+  }
+  return rename(path_old, path_new) == 0 ? FR_OK : errnoResult();
+}
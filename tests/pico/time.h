@@ -0,0 +1,23 @@
+// Simulated clock of the host tests, instead of the one of the benchmark: the
+// time the simulated flash was busy, plus the idle time the test lets pass
+// with testIdleUs. It does not depend on the speed of the host, so the tests
+// can check deadlines
+#ifndef TEST_PICO_TIME_H
+#define TEST_PICO_TIME_H
+
+#include <stdint.h>
+
+#include "nor_flash.h"
+
+extern uint64_t testIdleUs;
+
+static inline uint64_t time_us_64() {
+  if (nor_flash_memory == NULL) {
+    return testIdleUs;  // The flash is not used
+  }
+  NorFlashStats stats;
+  nor_flash_get_stats(&stats);
+  return stats.busyUs + testIdleUs;
+}
+
+#endif // TEST_PICO_TIME_H
@@ -0,0 +1,36 @@
+/**
+ * @file test.h
+ * @author Diego Parrilla
+ * @date October 2026
+ * @copyright 2026 - GOODDATA LABS SL
+ *
+ * @brief Checks of the host tests of the settings library.
+ *
+ * A failed check prints where it failed and the test goes on, so one run
+ * shows every failure. TEST_RESULT() is the exit code of the test.
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+static int testFailures = 0;
+
+// Idle time of the simulated clock, in us. See pico/time.h
+uint64_t testIdleUs = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      testFailures++;                                                          \
+    }                                                                          \
+  } while (0)
+
+#define TEST_RESULT()                                                          \
+  (printf("%s: %s\n", __FILE__, testFailures == 0 ? "ok" : "FAILED"),          \
+   testFailures == 0 ? 0 : 1)
+
+#endif // TEST_H
@@ -0,0 +1,113 @@
+// Host test of the coroutine interface of settings.hpp: a minimal executor
+// runs co_await save() and flush() to completion on the simulated flash, one
+// step per turn of its loop.
+#include <coroutine>
+#include <deque>
+#include <utility>
+
+#include "nor_flash.h"
+#include "settings.hpp"
+#include "test.h"
+
+#define TEST_OFFSET 0x100000
+#define TEST_SIZE 4096
+#define TEST_MAGIC 0x7E57
+#define TEST_VERSION 1
+
+static const SettingsConfigEntry defaults[] = {
+    {"BOOT_DELAY", SETTINGS_TYPE_INT, "5"},
+    {"HOSTNAME", SETTINGS_TYPE_STRING, "sidecart"}};
+
+// Event loop of the test: a queue of functions, one called per turn
+class Loop : public settings::Executor {
+ public:
+  void post(void (*fn)(void *ctx), void *ctx) override {
+    queue_.emplace_back(fn, ctx);
+  }
+
+  // Run until the queue is empty. Returns the number of turns
+  int run() {
+    int turns = 0;
+    while (!queue_.empty()) {
+      auto [fn, ctx] = queue_.front();
+      queue_.pop_front();
+      fn(ctx);
+      turns++;
+    }
+    return turns;
+  }
+
+ private:
+  std::deque<std::pair<void (*)(void *), void *>> queue_;
+};
+
+// Coroutine started right away and never awaited, like a task of the loop
+struct Task {
+  struct promise_type {
+    Task get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() {}
+  };
+};
+
+static Task saveTask(settings::Settings &store, int *result) {
+  *result = co_await store.save();
+}
+
+static Task flushTask(settings::Settings &store, int *result) {
+  *result = co_await store.flush();
+}
+
+static void boot() {
+  settings_init(defaults, sizeof(defaults) / sizeof(defaults[0]), TEST_OFFSET,
+                TEST_SIZE, TEST_MAGIC, TEST_VERSION);
+}
+
+int main() {
+  nor_flash_init();
+  Loop loop;
+  settings::Settings store(loop);
+  boot();
+
+  // The save runs from the loop, a step per turn, and resumes the coroutine
+  int result = 1;
+  CHECK(settings_put_integer("BOOT_DELAY", 10) == 0);
+  saveTask(store, &result);
+  CHECK(result == 1);
+  CHECK(loop.run() > 2);
+  CHECK(result == 0);
+  boot();
+  CHECK(strcmp(settings_find_entry("BOOT_DELAY")->value, "10") == 0);
+
+  // The save does not start before co_await, and a save that cannot start
+  // does not suspend
+  settings::SaveAwaiter awaiter = store.save();
+  CHECK(settings_save_begin() == 0);
+  saveTask(store, &result);
+  CHECK(result != 0);
+  int status = SETTINGS_SAVE_IN_PROGRESS;
+  while (status == SETTINGS_SAVE_IN_PROGRESS) {
+    status = settings_save_step();
+  }
+  CHECK(status == 0);
+  (void)awaiter;
+
+  // A flush runs the operations of other writers
+  static uint8_t page[NOR_PAGE_SIZE];
+  SettingsFlashOp op = {};
+  op.type = SETTINGS_FLASH_PROGRAM;
+  op.offset = TEST_OFFSET + TEST_SIZE;
+  op.count = sizeof(page);
+  op.data = page;
+  op.deadlineUs = time_us_64() + 1000000;
+  CHECK(settings_flash_submit(&op) == 0);
+  result = 1;
+  flushTask(store, &result);
+  CHECK(loop.run() == 1);
+  CHECK(result == 0);
+  CHECK(op.status == 0);
+
+  return TEST_RESULT();
+}
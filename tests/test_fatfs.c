@@ -0,0 +1,123 @@
+// Host test of the FatFs storage, on the files of the host through the shim
+// in ff_posix.c: the replace of the file through a temporary file, the
+// recovery of a replace interrupted by a reset, and the reload of a file
+// changed by another writer.
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "settings_fatfs.h"
+#include "test.h"
+
+#define TEST_PATH "settings.bin"
+#define TEST_TEMP_PATH TEST_PATH SETTINGS_FATFS_TEMP_SUFFIX
+#define TEST_BACKUP_PATH TEST_PATH SETTINGS_FATFS_BACKUP_SUFFIX
+#define TEST_SIZE 4096
+#define TEST_MAGIC 0x7E57
+#define TEST_VERSION 1
+
+static const SettingsConfigEntry defaults[] = {
+    {"BOOT_DELAY", SETTINGS_TYPE_INT, "5"},
+    {"HOSTNAME", SETTINGS_TYPE_STRING, "sidecart"}};
+
+static SettingsFatfsStorage storage;
+
+static int boot() {
+  if (settings_fatfs_init(&storage, TEST_PATH) != 0) {
+    return -1;
+  }
+  settings_set_storage(&settings_fatfs_ops, &storage);
+  settings_init(defaults, sizeof(defaults) / sizeof(defaults[0]), 0,
+                TEST_SIZE, TEST_MAGIC, TEST_VERSION);
+  return 0;
+}
+
+static int bootDelay() { return atoi(settings_find_entry("BOOT_DELAY")->value); }
+
+static bool exists(const char *path) { return access(path, F_OK) == 0; }
+
+static size_t readFile(const char *path, uint8_t *buffer) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return 0;
+  }
+  size_t size = fread(buffer, 1, TEST_SIZE, file);
+  fclose(file);
+  return size;
+}
+
+static void writeFile(const char *path, const uint8_t *data, size_t size) {
+  FILE *file = fopen(path, "wb");
+  if (file != NULL) {
+    fwrite(data, 1, size, file);
+    fclose(file);
+  }
+}
+
+static uint8_t image20[TEST_SIZE];
+static uint8_t image30[TEST_SIZE];
+
+int main() {
+  char dir[] = "/tmp/test_fatfs.XXXXXX";
+  if (mkdtemp(dir) == NULL || chdir(dir) != 0) {
+    perror(dir);
+    return 1;
+  }
+
+  // A save creates the file, and the next one replaces it
+  CHECK(boot() == 0);
+  CHECK(bootDelay() == 5);
+  CHECK(settings_put_integer("BOOT_DELAY", 10) == 0);
+  CHECK(settings_save() == 0);
+  CHECK(exists(TEST_PATH));
+  CHECK(settings_put_integer("BOOT_DELAY", 20) == 0);
+  CHECK(settings_save() == 0);
+  CHECK(!exists(TEST_TEMP_PATH) && !exists(TEST_BACKUP_PATH));
+  CHECK(boot() == 0);
+  CHECK(bootDelay() == 20);
+  size_t size20 = readFile(TEST_PATH, image20);
+  CHECK(settings_put_integer("BOOT_DELAY", 30) == 0);
+  CHECK(settings_save() == 0);
+  size_t size30 = readFile(TEST_PATH, image30);
+  CHECK(size20 > 0 && size30 > 0);
+
+  // A temporary file left alone was not completely written
+  writeFile(TEST_TEMP_PATH, image20, size20 / 2);
+  CHECK(boot() == 0);
+  CHECK(!exists(TEST_TEMP_PATH));
+  CHECK(bootDelay() == 30);
+
+  // Reset after the file was renamed to the backup: the replace completes
+  CHECK(rename(TEST_PATH, TEST_TEMP_PATH) == 0);
+  writeFile(TEST_BACKUP_PATH, image20, size20);
+  CHECK(boot() == 0);
+  CHECK(exists(TEST_PATH) && !exists(TEST_TEMP_PATH) &&
+        !exists(TEST_BACKUP_PATH));
+  CHECK(bootDelay() == 30);
+
+  // Only the backup is left: it is restored
+  CHECK(rename(TEST_PATH, TEST_BACKUP_PATH) == 0);
+  CHECK(boot() == 0);
+  CHECK(exists(TEST_PATH) && !exists(TEST_BACKUP_PATH));
+  CHECK(bootDelay() == 30);
+
+  // A reload sees a file created, then replaced, by another writer
+  CHECK(remove(TEST_PATH) == 0);
+  CHECK(boot() == 0);
+  CHECK(bootDelay() == 5);
+  CHECK(settings_reload() == 0);
+  writeFile(TEST_PATH, image20, size20);
+  CHECK(settings_reload() == 1);
+  CHECK(bootDelay() == 20);
+  writeFile(TEST_PATH ".new", image30, size30);
+  CHECK(remove(TEST_PATH) == 0);
+  CHECK(rename(TEST_PATH ".new", TEST_PATH) == 0);
+  CHECK(settings_reload() == 1);
+  CHECK(bootDelay() == 30);
+
+  // Erasing removes every file
+  CHECK(settings_erase() == 0);
+  CHECK(!exists(TEST_PATH));
+  CHECK(rmdir(dir) == 0);
+
+  return TEST_RESULT();
+}
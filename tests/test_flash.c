@@ -0,0 +1,83 @@
+// Host test of the deadlines of the flash scheduler, on the simulated clock:
+// settings_flash_poll() starts the operations early enough to end them before
+// their deadline.
+#include <pico/time.h>
+#include <string.h>
+
+#include "nor_flash.h"
+#include "settings_flash.h"
+#include "test.h"
+
+#define TEST_OFFSET 0x100000
+#define TEST_POLL_US 1000
+
+static uint8_t pages[16 * NOR_PAGE_SIZE];
+
+static void opDone(SettingsFlashOp *op, void *ctx) {
+  *(uint64_t *)ctx = time_us_64();
+}
+
+static void queueOp(SettingsFlashOp *op, SettingsFlashOpType type,
+                    uint32_t offset, size_t count, uint8_t priority,
+                    uint64_t deadlineUs, uint64_t *doneUs) {
+  memset(op, 0, sizeof(SettingsFlashOp));
+  op->type = type;
+  op->offset = offset;
+  op->count = count;
+  op->data = pages;
+  op->priority = priority;
+  op->deadlineUs = deadlineUs;
+  op->done = opDone;
+  op->ctx = doneUs;
+  CHECK(settings_flash_submit(op) == 0);
+}
+
+// Poll from an idle main loop until the operation is complete
+static void pollUntilDone(const SettingsFlashOp *op) {
+  for (int i = 0; i < 10000 && op->status == SETTINGS_FLASH_PENDING; i++) {
+    testIdleUs += TEST_POLL_US;
+    settings_flash_poll();
+  }
+  CHECK(op->status == 0);
+}
+
+int main() {
+  nor_flash_init();
+  SettingsFlashOp erase, program, first;
+  uint64_t eraseDoneUs = 0, programDoneUs = 0, firstDoneUs = 0;
+
+  // An erase waits to be batched, but not past its deadline
+  uint64_t deadlineUs = time_us_64() + 10 * NOR_ERASE_SECTOR_US;
+  queueOp(&erase, SETTINGS_FLASH_ERASE, TEST_OFFSET, 4 * NOR_SECTOR_SIZE, 10,
+          deadlineUs, &eraseDoneUs);
+  CHECK(settings_flash_poll() == 0);
+  pollUntilDone(&erase);
+  CHECK(eraseDoneUs <= deadlineUs);
+  CHECK(eraseDoneUs + TEST_POLL_US + 4 * NOR_ERASE_SECTOR_US > deadlineUs);
+
+  // Also a program, with the measured duration of the pages
+  deadlineUs = time_us_64() + 100 * NOR_PROGRAM_PAGE_US;
+  queueOp(&program, SETTINGS_FLASH_PROGRAM, TEST_OFFSET, sizeof(pages), 10,
+          deadlineUs, &programDoneUs);
+  pollUntilDone(&program);
+  CHECK(programDoneUs <= deadlineUs);
+
+  // The operations before it in the queue count: they run first
+  deadlineUs = time_us_64() + 10 * NOR_ERASE_SECTOR_US;
+  queueOp(&first, SETTINGS_FLASH_ERASE, TEST_OFFSET, 4 * NOR_SECTOR_SIZE, 200,
+          time_us_64() + 100 * NOR_ERASE_SECTOR_US, &firstDoneUs);
+  queueOp(&erase, SETTINGS_FLASH_ERASE, TEST_OFFSET + 4 * NOR_SECTOR_SIZE,
+          4 * NOR_SECTOR_SIZE, 10, deadlineUs, &eraseDoneUs);
+  pollUntilDone(&erase);
+  CHECK(first.status == 0);
+  CHECK(eraseDoneUs <= deadlineUs);
+
+  // Operations without a deadline run at once
+  uint64_t startUs = time_us_64();
+  queueOp(&erase, SETTINGS_FLASH_ERASE, TEST_OFFSET, NOR_SECTOR_SIZE, 10, 0,
+          &eraseDoneUs);
+  CHECK(settings_flash_poll() == 1);
+  CHECK(eraseDoneUs == startUs + NOR_ERASE_SECTOR_US);
+
+  return TEST_RESULT();
+}
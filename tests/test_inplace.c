@@ -0,0 +1,138 @@
+// Host test of the saves of storages written in place, like FRAM, on a file
+// of the host: a save only writes the records that changed, plus the magic
+// entry, and reads nothing back.
+#include <stdlib.h>
+
+#include "settings.h"
+#include "test.h"
+
+#define TEST_SIZE 4096
+#define TEST_MAGIC 0x7E57
+#define TEST_VERSION 1
+#define TEST_RECORD(n) ((n) * sizeof(SettingsConfigEntry))
+
+static const SettingsConfigEntry defaults[] = {
+    {"BOOT_DELAY", SETTINGS_TYPE_INT, "5"},
+    {"HOSTNAME", SETTINGS_TYPE_STRING, "sidecart"},
+    {"VERBOSE", SETTINGS_TYPE_BOOL, "false"}};
+#define TEST_ENTRIES (sizeof(defaults) / sizeof(defaults[0]))
+
+typedef struct {
+  FILE *file;
+  int reads;
+  int writes;
+  int failWrite;  // Write that fails, counting from 1, or 0 for none
+  uint32_t lastOffset;
+} FileStorage;
+
+static int fileRead(uint32_t offset, void *buffer, size_t len, void *ctx) {
+  FileStorage *storage = (FileStorage *)ctx;
+  storage->reads++;
+  memset(buffer, 0, len);  // Past the end of the file
+  if (fseek(storage->file, offset, SEEK_SET) != 0) {
+    return -1;
+  }
+  fread(buffer, 1, len, storage->file);
+  return ferror(storage->file) ? -1 : 0;
+}
+
+static int fileWrite(uint32_t offset, const void *data, size_t len,
+                     void *ctx) {
+  FileStorage *storage = (FileStorage *)ctx;
+  if (++storage->writes == storage->failWrite) {
+    return -1;
+  }
+  storage->lastOffset = offset;
+  return fseek(storage->file, offset, SEEK_SET) == 0 &&
+                 fwrite(data, 1, len, storage->file) == len
+             ? 0
+             : -1;
+}
+
+static int fileErase(void *ctx) {
+  static const uint8_t emptyRecord[sizeof(SettingsConfigEntry)] = {0};
+  return fileWrite(0, emptyRecord, sizeof(emptyRecord), ctx);
+}
+
+static const SettingsStorageOps fileOps = {.read = fileRead,
+                                           .write = fileWrite,
+                                           .erase = fileErase,
+                                           .inPlace = true};
+
+static FileStorage storage;
+
+static void boot() {
+  settings_set_storage(&fileOps, &storage);
+  settings_init(defaults, TEST_ENTRIES, 0, TEST_SIZE, TEST_MAGIC,
+                TEST_VERSION);
+}
+
+// Save and count the accesses to the storage
+static int save() {
+  storage.reads = 0;
+  storage.writes = 0;
+  return settings_save();
+}
+
+int main() {
+  storage.file = tmpfile();
+  if (storage.file == NULL) {
+    perror("tmpfile");
+    return 1;
+  }
+
+  // The first save writes every record, the end mark and the magic entry last
+  boot();
+  CHECK(save() == 0);
+  CHECK(storage.writes == TEST_ENTRIES + 2);
+  CHECK(storage.lastOffset == TEST_RECORD(0));
+  CHECK(storage.reads == 0);
+  CHECK(settings_reload() == 0);
+
+  // Then only the records that changed, and the magic entry
+  CHECK(settings_put_integer("BOOT_DELAY", 10) == 0);
+  CHECK(save() == 0);
+  CHECK(storage.writes == 2);
+  CHECK(storage.reads == 0);
+  CHECK(save() == 0);
+  CHECK(storage.writes == 1);
+  CHECK(settings_reload() == 0);
+
+  // Also after loading the image again
+  boot();
+  CHECK(strcmp(settings_find_entry("BOOT_DELAY")->value, "10") == 0);
+  CHECK(settings_put_bool("VERBOSE", true) == 0);
+  CHECK(save() == 0);
+  CHECK(storage.writes == 2);
+  CHECK(storage.reads == 0);
+  CHECK(settings_reload() == 0);
+
+  // Also a value changed through the pointer of the entry
+  strcpy(settings_find_entry("BOOT_DELAY")->value, "15");
+  CHECK(save() == 0);
+  CHECK(storage.writes == 2);
+  boot();
+  CHECK(strcmp(settings_find_entry("BOOT_DELAY")->value, "15") == 0);
+
+  // A record changed by someone else is reloaded, and not written again
+  SettingsConfigEntry hostname = {"HOSTNAME", SETTINGS_TYPE_STRING, "atari"};
+  fileWrite(TEST_RECORD(2), &hostname, sizeof(hostname), &storage);
+  CHECK(settings_reload() == 1);
+  CHECK(strcmp(settings_find_entry("HOSTNAME")->value, "atari") == 0);
+  CHECK(save() == 0);
+  CHECK(storage.writes == 1);
+
+  // After a failed save, every record is written again
+  CHECK(settings_put_integer("BOOT_DELAY", 20) == 0);
+  storage.failWrite = 2;
+  CHECK(save() != 0);
+  storage.failWrite = 0;
+  CHECK(save() == 0);
+  CHECK(storage.writes == TEST_ENTRIES + 1);
+  boot();
+  CHECK(strcmp(settings_find_entry("BOOT_DELAY")->value, "20") == 0);
+  CHECK(strcmp(settings_find_entry("HOSTNAME")->value, "atari") == 0);
+
+  fclose(storage.file);
+  return TEST_RESULT();
+}
@@ -0,0 +1,64 @@
+// Host test of the persistence policies: a write-once key is only locked
+// once it is saved with a value other than its default one.
+#include "nor_flash.h"
+#include "settings.h"
+#include "test.h"
+
+#define TEST_OFFSET 0x100000
+#define TEST_SIZE 4096
+#define TEST_MAGIC 0x7E57
+#define TEST_VERSION 1
+
+static const SettingsConfigEntry defaults[] = {
+    {"BOOT_DELAY", SETTINGS_TYPE_INT, "5"},
+    {"SESSION", SETTINGS_TYPE_INT, "0"},
+    {"SERIAL", SETTINGS_TYPE_STRING, ""}};
+
+static const SettingsKeyPolicy policies[] = {
+    {"SESSION", SETTINGS_POLICY_VOLATILE},
+    {"SERIAL", SETTINGS_POLICY_WRITE_ONCE}};
+
+static void boot() {
+  settings_set_policies(policies, sizeof(policies) / sizeof(policies[0]));
+  settings_init(defaults, sizeof(defaults) / sizeof(defaults[0]), TEST_OFFSET,
+                TEST_SIZE, TEST_MAGIC, TEST_VERSION);
+}
+
+static const char *serial() { return settings_find_entry("SERIAL")->value; }
+
+int main() {
+  nor_flash_init();
+  boot();
+
+  // Saving an unrelated key leaves the unprovisioned serial writable
+  CHECK(settings_put_integer("BOOT_DELAY", 10) == 0);
+  CHECK(settings_save() == 0);
+  boot();
+  CHECK(settings_put_string("SERIAL", "SN0001") == 0);
+  CHECK(settings_save() == 0);
+
+  // Once saved with a value, it is fixed, also after a reboot
+  CHECK(settings_put_string("SERIAL", "SN0002") != 0);
+  boot();
+  CHECK(strcmp(serial(), "SN0001") == 0);
+  CHECK(settings_put_string("SERIAL", "SN0002") != 0);
+
+  // Volatile keys are never saved
+  CHECK(settings_put_integer("SESSION", 7) == 0);
+  CHECK(settings_save() == 0);
+  boot();
+  CHECK(strcmp(settings_find_entry("SESSION")->value, "0") == 0);
+
+  // A serial written but not saved is not locked by a reload of the policies
+  nor_flash_reset();
+  boot();
+  CHECK(settings_put_string("SERIAL", "SN0003") == 0);
+  boot();
+  CHECK(strcmp(serial(), "") == 0);
+  CHECK(settings_put_string("SERIAL", "SN0004") == 0);
+  CHECK(settings_put_string("SERIAL", "SN0005") == 0);
+  CHECK(settings_save() == 0);
+  CHECK(settings_put_string("SERIAL", "SN0006") != 0);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,499 @@
+/**
+ * @file bench.c
+ * @author Diego Parrilla
+ * @date October 2026
+ * @copyright 2026 - GOODDATA LABS SL
+ *
+ * @brief Host benchmark of the settings library against littlefs and
+ * FlashDB, when their submodules are checked out, on the same simulated NOR
+ * flash and with the same workloads: boot, random gets, bursts of puts
+ * followed by a commit, and power cuts in the middle of a burst.
+ *
+ * The latency of each operation is the time it takes on the host plus the
+ * modelled time the flash was busy (see nor_flash.h), so the flash dominates
+ * as it does on the board. Results are printed as CSV.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "nor_flash.h"
+
+// Region of the simulated flash used by every store
+#define BENCH_REGION_OFFSET 0x100000
+#define BENCH_REGION_SIZE (256 * 1024)
+
+#define BENCH_DEFAULT_KEYS 64
+#define BENCH_DEFAULT_BOOTS 20
+#define BENCH_DEFAULT_GETS 1000
+#define BENCH_DEFAULT_BURSTS 50
+#define BENCH_DEFAULT_BURST_PUTS 5
+#define BENCH_DEFAULT_CUTS 100
+#define BENCH_DEFAULT_SEED 1
+
+typedef struct {
+  unsigned keys;
+  unsigned boots;
+  unsigned gets;
+  unsigned bursts;
+  unsigned burstPuts;
+  unsigned cuts;
+  uint32_t seed;
+} BenchOptions;
+
+// Time and flash counters when an operation starts
+typedef struct {
+  uint64_t us;
+  NorFlashStats flash;
+} BenchMark;
+
+// Latencies and flash used by the operations of a workload
+typedef struct {
+  uint32_t *samples;
+  size_t count;
+  NorFlashStats flash;
+} BenchRow;
+
+// Classification of the values found after a power cut
+enum { CUT_OLD = 0, CUT_NEW, CUT_MIXED, CUT_LOST, CUT_RESULTS };
+
+// Value of each key in the store, as far as the benchmark knows
+static char (*expected)[BENCH_VALUE_LENGTH] = NULL;
+static uint32_t randomState = 1;
+
+void bench_key(unsigned index, char *key) {
+  snprintf(key, BENCH_KEY_LENGTH, "KEY_%04u", index);
+}
+
+void bench_initial_value(unsigned index, char *value) {
+  snprintf(value, BENCH_VALUE_LENGTH, "initial value of key %u", index);
+}
+
+// xorshift32, so every store gets the same sequence of keys
+static uint32_t benchRandom() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+static void benchMark(BenchMark *mark) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  mark->us = (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+  nor_flash_get_stats(&mark->flash);
+}
+
+static void rowInit(BenchRow *row, uint32_t *samples) {
+  row->samples = samples;
+  row->count = 0;
+  memset(&row->flash, 0, sizeof(row->flash));
+}
+
+// Add the operation started at mark to the row
+static void rowAdd(BenchRow *row, const BenchMark *mark) {
+  BenchMark end;
+  benchMark(&end);
+  uint64_t busyUs = end.flash.busyUs - mark->flash.busyUs;
+  row->samples[row->count++] = (uint32_t)(end.us - mark->us + busyUs);
+  row->flash.bytesProgrammed +=
+      end.flash.bytesProgrammed - mark->flash.bytesProgrammed;
+  row->flash.sectorsErased +=
+      end.flash.sectorsErased - mark->flash.sectorsErased;
+  row->flash.busyUs += busyUs;
+}
+
+static int compareSamples(const void *a, const void *b) {
+  uint32_t left = *(const uint32_t *)a;
+  uint32_t right = *(const uint32_t *)b;
+  return (left > right) - (left < right);
+}
+
+// Print the distribution of the latencies and the flash used as a CSV row
+static void rowPrint(BenchRow *row, const char *store, const char *workload) {
+  size_t count = row->count;
+  if (count == 0) {
+    return;
+  }
+  uint64_t total = 0;
+  for (size_t i = 0; i < count; i++) {
+    total += row->samples[i];
+  }
+  qsort(row->samples, count, sizeof(row->samples[0]), compareSamples);
+  printf("%s,%s,%zu,%u,%u,%u,%llu,%llu,%llu,%.1f\n", store, workload, count,
+         row->samples[count / 2], row->samples[count * 99 / 100],
+         row->samples[count - 1], (unsigned long long)(total / count),
+         (unsigned long long)row->flash.bytesProgrammed,
+         (unsigned long long)row->flash.sectorsErased,
+         row->flash.busyUs / 1000.0);
+}
+
+// Choose the keys and new values of a burst. A key can appear twice
+static void benchDrawBurst(const BenchOptions *options, unsigned burst,
+                           unsigned *indexes,
+                           char (*values)[BENCH_VALUE_LENGTH]) {
+  for (unsigned i = 0; i < options->burstPuts; i++) {
+    indexes[i] = benchRandom() % options->keys;
+    snprintf(values[i], BENCH_VALUE_LENGTH, "burst %u value %u", burst, i);
+  }
+}
+
+static int benchPutBurst(const BenchStore *store, const BenchOptions *options,
+                         const unsigned *indexes,
+                         char (*values)[BENCH_VALUE_LENGTH], BenchRow *row) {
+  char key[BENCH_KEY_LENGTH];
+  for (unsigned i = 0; i < options->burstPuts; i++) {
+    bench_key(indexes[i], key);
+    BenchMark mark;
+    benchMark(&mark);
+    if (store->put(key, values[i]) != 0) {
+      return -1;
+    }
+    if (row != NULL) {
+      rowAdd(row, &mark);
+    }
+  }
+  return 0;
+}
+
+// Write every key with its initial value, so all the stores start equal
+static int benchPopulate(const BenchStore *store, const BenchOptions *options,
+                         BenchRow *row) {
+  BenchMark mark;
+  benchMark(&mark);
+  if (store->boot() != 0) {
+    return -1;
+  }
+  char key[BENCH_KEY_LENGTH];
+  for (unsigned i = 0; i < options->keys; i++) {
+    bench_key(i, key);
+    bench_initial_value(i, expected[i]);
+    if (store->put(key, expected[i]) != 0) {
+      return -1;
+    }
+  }
+  if (store->commit() != 0) {
+    return -1;
+  }
+  rowAdd(row, &mark);
+  return 0;
+}
+
+static int benchBoot(const BenchStore *store, const BenchOptions *options,
+                     BenchRow *row) {
+  for (unsigned i = 0; i < options->boots; i++) {
+    BenchMark mark;
+    benchMark(&mark);
+    if (store->boot() != 0) {
+      return -1;
+    }
+    rowAdd(row, &mark);
+  }
+  return 0;
+}
+
+static int benchGet(const BenchStore *store, const BenchOptions *options,
+                    BenchRow *row) {
+  char key[BENCH_KEY_LENGTH];
+  char value[BENCH_VALUE_LENGTH];
+  for (unsigned i = 0; i < options->gets; i++) {
+    unsigned index = benchRandom() % options->keys;
+    bench_key(index, key);
+    BenchMark mark;
+    benchMark(&mark);
+    if (store->get(key, value, sizeof(value)) != 0) {
+      return -1;
+    }
+    rowAdd(row, &mark);
+    if (strcmp(value, expected[index]) != 0) {
+      fprintf(stderr, "%s: wrong value of %s\n", store->name, key);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int benchBursts(const BenchStore *store, const BenchOptions *options,
+                       BenchRow *putRow, BenchRow *commitRow) {
+  unsigned indexes[options->burstPuts];
+  char values[options->burstPuts][BENCH_VALUE_LENGTH];
+  for (unsigned burst = 0; burst < options->bursts; burst++) {
+    benchDrawBurst(options, burst, indexes, values);
+    if (benchPutBurst(store, options, indexes, values, putRow) != 0) {
+      return -1;
+    }
+    BenchMark mark;
+    benchMark(&mark);
+    if (store->commit() != 0) {
+      return -1;
+    }
+    rowAdd(commitRow, &mark);
+    for (unsigned i = 0; i < options->burstPuts; i++) {
+      strcpy(expected[indexes[i]], values[i]);
+    }
+  }
+  return 0;
+}
+
+// Run a burst and its commit in a child process, and cut its power after a
+// number of flash operations, or never with 0. Returns the operations done
+static int64_t benchChildBurst(const BenchStore *store,
+                               const BenchOptions *options,
+                               const unsigned *indexes,
+                               char (*values)[BENCH_VALUE_LENGTH],
+                               uint64_t cutAfter) {
+  NorFlashStats before;
+  NorFlashStats after;
+  nor_flash_get_stats(&before);
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (store->boot() != 0) {
+      _exit(1);
+    }
+    nor_flash_cut_after(cutAfter);
+    if (benchPutBurst(store, options, indexes, values, NULL) != 0 ||
+        store->commit() != 0) {
+      _exit(1);
+    }
+    _exit(0);
+  }
+  int status = 0;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+      (WEXITSTATUS(status) != 0 &&
+       WEXITSTATUS(status) != NOR_POWER_CUT_EXIT)) {
+    return -1;
+  }
+  // The boot of a complete store does not use the flash, so these are the
+  // operations of the burst
+  nor_flash_get_stats(&after);
+  return (int64_t)(after.operations - before.operations);
+}
+
+// Boot after a burst and classify the values of its keys. The expected
+// values follow the store, except the lost ones
+static int benchCheckBurst(const BenchStore *store, const BenchOptions *options,
+                           const unsigned *indexes,
+                           char (*values)[BENCH_VALUE_LENGTH]) {
+  if (store->boot() != 0) {
+    return CUT_LOST;
+  }
+  char key[BENCH_KEY_LENGTH];
+  char value[BENCH_VALUE_LENGTH];
+  unsigned numOld = 0;
+  unsigned numNew = 0;
+  unsigned numLost = 0;
+  for (unsigned i = 0; i < options->keys; i++) {
+    // The last put of a key is its new value
+    const char *newValue = NULL;
+    for (unsigned j = 0; j < options->burstPuts; j++) {
+      newValue = indexes[j] == i ? values[j] : newValue;
+    }
+    bench_key(i, key);
+    if (store->get(key, value, sizeof(value)) != 0) {
+      numLost++;
+    } else if (strcmp(value, expected[i]) == 0) {
+      numOld += newValue != NULL;
+    } else if (newValue != NULL && strcmp(value, newValue) == 0) {
+      strcpy(expected[i], value);
+      numNew++;
+    } else {
+      numLost++;
+    }
+  }
+  if (numLost > 0) {
+    return CUT_LOST;
+  }
+  if (numNew == 0) {
+    return CUT_OLD;
+  }
+  return numOld == 0 ? CUT_NEW : CUT_MIXED;
+}
+
+// Write back the values lost by a power cut, so every cut starts from a
+// complete store
+static int benchRepair(const BenchStore *store, const BenchOptions *options) {
+  char key[BENCH_KEY_LENGTH];
+  char value[BENCH_VALUE_LENGTH];
+  bool changed = false;
+  for (unsigned i = 0; i < options->keys; i++) {
+    bench_key(i, key);
+    if (store->get(key, value, sizeof(value)) != 0 ||
+        strcmp(value, expected[i]) != 0) {
+      if (store->put(key, expected[i]) != 0) {
+        return -1;
+      }
+      changed = true;
+    }
+  }
+  return changed ? store->commit() : 0;
+}
+
+// Cut the power at a random flash operation of each burst, then boot and
+// check that the keys of the burst have either all their old values or all
+// their new ones
+static int benchPowerCuts(const BenchStore *store,
+                          const BenchOptions *options) {
+  unsigned indexes[options->burstPuts];
+  char values[options->burstPuts][BENCH_VALUE_LENGTH];
+  unsigned results[CUT_RESULTS] = {0};
+  unsigned burst = options->bursts;
+  for (unsigned cut = 0; cut < options->cuts; cut++) {
+    // A burst without cut counts the operations there are to cut
+    benchDrawBurst(options, burst++, indexes, values);
+    int64_t operations = benchChildBurst(store, options, indexes, values, 0);
+    if (operations < 0 ||
+        benchCheckBurst(store, options, indexes, values) != CUT_NEW) {
+      fprintf(stderr, "%s: burst without power cut failed\n", store->name);
+      return -1;
+    }
+    if (operations == 0) {
+      continue;
+    }
+    benchDrawBurst(options, burst++, indexes, values);
+    uint64_t cutAfter = 1 + benchRandom() % (uint64_t)operations;
+    if (benchChildBurst(store, options, indexes, values, cutAfter) < 0) {
+      fprintf(stderr, "%s: burst with power cut failed\n", store->name);
+      return -1;
+    }
+    results[benchCheckBurst(store, options, indexes, values)]++;
+    if (benchRepair(store, options) != 0) {
+      fprintf(stderr, "%s: repair after power cut failed\n", store->name);
+      return -1;
+    }
+  }
+  printf("%s,%u,%u,%u,%u,%u\n", store->name, options->cuts, results[CUT_OLD],
+         results[CUT_NEW], results[CUT_MIXED], results[CUT_LOST]);
+  return 0;
+}
+
+static int benchStore(const BenchStore *store, const BenchOptions *options,
+                      bool powerCuts) {
+  nor_flash_reset();
+  randomState = options->seed;
+  size_t numSamples = 1 + options->boots + options->gets +
+                      options->bursts * (options->burstPuts + 1);
+  uint32_t *samples = (uint32_t *)malloc(numSamples * sizeof(uint32_t));
+  if (samples == NULL) {
+    return -1;
+  }
+  // populate, boot, get, burst_put and burst_commit
+  BenchRow rows[5];
+  rowInit(&rows[0], samples);
+  rowInit(&rows[1], rows[0].samples + 1);
+  rowInit(&rows[2], rows[1].samples + options->boots);
+  rowInit(&rows[3], rows[2].samples + options->gets);
+  rowInit(&rows[4], rows[3].samples + options->bursts * options->burstPuts);
+
+  int err = store->setup(options->keys, BENCH_REGION_OFFSET,
+                         BENCH_REGION_SIZE) != 0 ||
+            benchPopulate(store, options, &rows[0]) != 0;
+  if (!powerCuts) {
+    err = err || benchBoot(store, options, &rows[1]) != 0 ||
+          benchGet(store, options, &rows[2]) != 0 ||
+          benchBursts(store, options, &rows[3], &rows[4]) != 0;
+    rowPrint(&rows[0], store->name, "populate");
+    rowPrint(&rows[1], store->name, "boot");
+    rowPrint(&rows[2], store->name, "get");
+    rowPrint(&rows[3], store->name, "burst_put");
+    rowPrint(&rows[4], store->name, "burst_commit");
+  } else {
+    err = err || benchPowerCuts(store, options) != 0;
+  }
+  free(samples);
+  if (err) {
+    fprintf(stderr, "%s: benchmark failed\n", store->name);
+  }
+  return err;
+}
+
+static void usage(FILE *out, const char *program) {
+  fprintf(out,
+          "Usage: %s [-h] [-k keys] [-r boots] [-g gets] [-b bursts] "
+          "[-p puts per burst] [-c power cuts] [-s seed]\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  BenchOptions options = {.keys = BENCH_DEFAULT_KEYS,
+                          .boots = BENCH_DEFAULT_BOOTS,
+                          .gets = BENCH_DEFAULT_GETS,
+                          .bursts = BENCH_DEFAULT_BURSTS,
+                          .burstPuts = BENCH_DEFAULT_BURST_PUTS,
+                          .cuts = BENCH_DEFAULT_CUTS,
+                          .seed = BENCH_DEFAULT_SEED};
+  int opt;
+  while ((opt = getopt(argc, argv, "hk:r:g:b:p:c:s:")) != -1) {
+    unsigned value = optarg != NULL ? (unsigned)strtoul(optarg, NULL, 0) : 0;
+    switch (opt) {
+      case 'h':
+        usage(stdout, argv[0]);
+        return 0;
+      case 'k':
+        options.keys = value;
+        break;
+      case 'r':
+        options.boots = value;
+        break;
+      case 'g':
+        options.gets = value;
+        break;
+      case 'b':
+        options.bursts = value;
+        break;
+      case 'p':
+        options.burstPuts = value;
+        break;
+      case 'c':
+        options.cuts = value;
+        break;
+      case 's':
+        options.seed = value != 0 ? value : BENCH_DEFAULT_SEED;
+        break;
+      default:
+        usage(stderr, argv[0]);
+        return 2;
+    }
+  }
+  if (options.keys == 0 || options.burstPuts == 0) {
+    usage(stderr, argv[0]);
+    return 2;
+  }
+
+  const BenchStore *stores[] = {
+      &bench_settings_store,
+#ifdef BENCH_LITTLEFS
+      &bench_littlefs_store,
+#endif
+#ifdef BENCH_FLASHDB
+      &bench_flashdb_store,
+#endif
+  };
+  size_t numStores = sizeof(stores) / sizeof(stores[0]);
+
+  nor_flash_init();
+  expected = calloc(options.keys, BENCH_VALUE_LENGTH);
+  if (expected == NULL) {
+    return 1;
+  }
+
+  int err = 0;
+  printf("store,workload,count,p50_us,p99_us,max_us,mean_us,"
+         "bytes_programmed,sectors_erased,flash_busy_ms\n");
+  for (size_t i = 0; i < numStores; i++) {
+    err |= benchStore(stores[i], &options, false);
+  }
+  if (options.cuts > 0) {
+    printf("\nstore,power_cuts,old,new,mixed,lost\n");
+    for (size_t i = 0; i < numStores; i++) {
+      err |= benchStore(stores[i], &options, true);
+    }
+  }
+  free(expected);
+  return err != 0 ? 1 : 0;
+}
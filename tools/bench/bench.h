@@ -0,0 +1,60 @@
+/**
+ * @file bench.h
+ * @author Diego Parrilla
+ * @date October 2026
+ * @copyright 2026 - GOODDATA LABS SL
+ *
+ * @brief Interface of the key-value stores run by the benchmark.
+ *
+ * Every store keeps its data in the simulated NOR flash of nor_flash.h, in
+ * the region given to setup(). All the functions return 0 on success and
+ * non-zero on error.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Maximum length of the keys and values of the workloads.
+ */
+#define BENCH_KEY_LENGTH 16
+#define BENCH_VALUE_LENGTH 48
+
+typedef struct {
+  const char *name;
+  /// Prepare the store for a number of keys, named by bench_key(). Called
+  /// once, with the flash erased, before the first boot.
+  int (*setup)(unsigned numKeys, uint32_t offset, uint32_t size);
+  /// Load the store from the flash, as after a reset. Formats it if needed.
+  int (*boot)();
+  /// Read a value. The benchmark writes every key before reading any.
+  int (*get)(const char *key, char *value, size_t size);
+  /// Write a value. It may only be persisted by commit().
+  int (*put)(const char *key, const char *value);
+  /// Persist the values written since the last commit.
+  int (*commit)();
+} BenchStore;
+
+/**
+ * @brief Name of the key number index.
+ */
+void bench_key(unsigned index, char *key);
+
+/**
+ * @brief Initial value of the key number index, written by the first commit.
+ */
+void bench_initial_value(unsigned index, char *value);
+
+extern const BenchStore bench_settings_store;
+#ifdef BENCH_LITTLEFS
+extern const BenchStore bench_littlefs_store;
+#endif
+#ifdef BENCH_FLASHDB
+extern const BenchStore bench_flashdb_store;
+#endif
+
+#endif // BENCH_H
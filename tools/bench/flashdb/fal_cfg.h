@@ -0,0 +1,21 @@
+// FAL configuration of the benchmark: one device in the simulated NOR flash,
+// at the region of the store, with one partition for the key-value database
+#ifndef BENCH_FAL_CFG_H
+#define BENCH_FAL_CFG_H
+
+#define BENCH_FAL_FLASH_NAME "bench_nor"
+#define BENCH_FAL_PART_NAME "kvdb"
+#define BENCH_FAL_PART_SIZE (64 * 1024)
+
+extern const struct fal_flash_dev bench_nor_flash;
+
+#define FAL_FLASH_DEV_TABLE {&bench_nor_flash}
+
+#define FAL_PART_HAS_TABLE_CFG
+#define FAL_PART_TABLE                                                         \
+  {                                                                            \
+    {FAL_PART_MAGIC_WORD, BENCH_FAL_PART_NAME, BENCH_FAL_FLASH_NAME, 0,        \
+     BENCH_FAL_PART_SIZE, 0},                                                  \
+  }
+
+#endif // BENCH_FAL_CFG_H
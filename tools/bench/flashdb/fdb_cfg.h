@@ -0,0 +1,11 @@
+// FlashDB configuration of the benchmark
+#ifndef BENCH_FDB_CFG_H
+#define BENCH_FDB_CFG_H
+
+#define FDB_USING_KVDB
+#define FDB_USING_FAL_MODE
+// NOR flash: any bit can be cleared, so it is written byte by byte
+#define FDB_WRITE_GRAN 1
+#define FDB_PRINT(...)
+
+#endif // BENCH_FDB_CFG_H
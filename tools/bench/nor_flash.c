@@ -0,0 +1,92 @@
+#include "nor_flash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+uint8_t *nor_flash_memory = NULL;
+
+// Shared with the child processes, like the memory
+static NorFlashStats *norStats = NULL;
+static uint64_t cutAfter = 0;
+
+void nor_flash_init() {
+  size_t size = NOR_FLASH_SIZE + sizeof(NorFlashStats);
+  uint8_t *memory = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    perror("mmap");
+    exit(1);
+  }
+  nor_flash_memory = memory;
+  norStats = (NorFlashStats *)(memory + NOR_FLASH_SIZE);
+  nor_flash_reset();
+}
+
+void nor_flash_reset() {
+  memset(nor_flash_memory, 0xFF, NOR_FLASH_SIZE);
+  memset(norStats, 0, sizeof(NorFlashStats));
+  cutAfter = 0;
+}
+
+// Count an operation, and cut the power if it is the last one. The operation
+// is done up to a pseudo random point
+static size_t norOperation(size_t size) {
+  norStats->operations++;
+  if (cutAfter == 0 || norStats->operations < cutAfter) {
+    return size;
+  }
+  return (size_t)(norStats->operations * 2654435761U) % size;
+}
+
+static void norPowerCut() {
+  fflush(stdout);
+  _exit(NOR_POWER_CUT_EXIT);
+}
+
+int nor_flash_erase(uint32_t offset, size_t size) {
+  if (offset % NOR_SECTOR_SIZE != 0 || size % NOR_SECTOR_SIZE != 0 ||
+      offset + size > NOR_FLASH_SIZE) {
+    return -1;
+  }
+  for (size_t sector = 0; sector < size; sector += NOR_SECTOR_SIZE) {
+    size_t done = norOperation(NOR_SECTOR_SIZE);
+    memset(nor_flash_memory + offset + sector, 0xFF, done);
+    norStats->sectorsErased++;
+    norStats->busyUs += NOR_ERASE_SECTOR_US;
+    if (done < NOR_SECTOR_SIZE) {
+      norPowerCut();
+    }
+  }
+  return 0;
+}
+
+int nor_flash_program(uint32_t offset, const uint8_t *data, size_t size) {
+  if (offset + size > NOR_FLASH_SIZE) {
+    return -1;
+  }
+  size_t done = norOperation(size);
+  for (size_t i = 0; i < done; i++) {
+    nor_flash_memory[offset + i] &= data[i];
+  }
+  norStats->bytesProgrammed += size;
+  // A partial page costs as much as a full one
+  norStats->busyUs +=
+      (size + NOR_PAGE_SIZE - 1) / NOR_PAGE_SIZE * NOR_PROGRAM_PAGE_US;
+  if (done < size) {
+    norPowerCut();
+  }
+  return 0;
+}
+
+void nor_flash_read(uint32_t offset, uint8_t *buffer, size_t size) {
+  memcpy(buffer, nor_flash_memory + offset, size);
+}
+
+void nor_flash_cut_after(uint64_t operations) {
+  cutAfter = operations != 0 ? norStats->operations + operations : 0;
+}
+
+void nor_flash_get_stats(NorFlashStats *stats) { *stats = *norStats; }
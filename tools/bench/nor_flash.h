@@ -0,0 +1,102 @@
+/**
+ * @file nor_flash.h
+ * @author Diego Parrilla
+ * @date October 2026
+ * @copyright 2026 - GOODDATA LABS SL
+ *
+ * @brief Simulated NOR flash shared by all the stores of the benchmark.
+ *
+ * Like a real NOR flash, erasing sets a whole sector to 0xFF and programming
+ * can only clear bits. The simulation counts the bytes programmed and the
+ * sectors erased, and adds the typical time of each operation to a model of
+ * the time the flash is busy. The memory is shared with the child processes,
+ * so a power cut in a child is seen by the next boot.
+ */
+
+#ifndef NOR_FLASH_H
+#define NOR_FLASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NOR_FLASH_SIZE (2 * 1024 * 1024)
+#define NOR_SECTOR_SIZE 4096
+#define NOR_PAGE_SIZE 256
+
+/**
+ * @brief Exit code of a process whose power was cut.
+ */
+#define NOR_POWER_CUT_EXIT 42
+
+/**
+ * @brief Typical times of a W25Q16 class flash, in us.
+ */
+#define NOR_ERASE_SECTOR_US 45000
+#define NOR_PROGRAM_PAGE_US 400
+
+/**
+ * @brief Counters of the simulated flash.
+ */
+typedef struct {
+  uint64_t bytesProgrammed; ///< Bytes programmed
+  uint64_t sectorsErased;   ///< Sectors erased
+  uint64_t busyUs;          ///< Modelled time the flash was busy, in us
+  uint64_t operations;      ///< Erase and program operations
+} NorFlashStats;
+
+extern uint8_t *nor_flash_memory;
+
+/**
+ * @brief Map the flash, erased, and clear the counters.
+ */
+void nor_flash_init();
+
+/**
+ * @brief Erase the whole flash and clear the counters.
+ */
+void nor_flash_reset();
+
+/**
+ * @brief Erase sectors. Offset and size must be aligned to the sector.
+ *
+ * @return int 0 on success, -1 if not aligned or out of range.
+ */
+int nor_flash_erase(uint32_t offset, size_t size);
+
+/**
+ * @brief Program bytes. They must not cross a page.
+ *
+ * @return int 0 on success, -1 if out of range.
+ */
+int nor_flash_program(uint32_t offset, const uint8_t *data, size_t size);
+
+/**
+ * @brief Read bytes.
+ */
+void nor_flash_read(uint32_t offset, uint8_t *buffer, size_t size);
+
+/**
+ * @brief Cut the power after a number of operations.
+ *
+ * The operation that reaches the count is left half done and the process
+ * exits, as if the board lost power. Only used in child processes.
+ *
+ * @param operations Operations before the cut, or 0 to never cut.
+ */
+void nor_flash_cut_after(uint64_t operations);
+
+/**
+ * @brief Get the counters of the flash.
+ */
+void nor_flash_get_stats(NorFlashStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NOR_FLASH_H
@@ -0,0 +1,22 @@
+// Host version of the flash functions of the Pico SDK, on the simulated NOR
+// flash of the benchmark. The flash is "mapped" at XIP_BASE
+#ifndef BENCH_HARDWARE_FLASH_H
+#define BENCH_HARDWARE_FLASH_H
+
+#include "nor_flash.h"
+
+#define XIP_BASE ((uintptr_t)nor_flash_memory)
+#define FLASH_PAGE_SIZE NOR_PAGE_SIZE
+#define FLASH_SECTOR_SIZE NOR_SECTOR_SIZE
+#define PICO_FLASH_SIZE_BYTES NOR_FLASH_SIZE
+
+static inline void flash_range_erase(uint32_t offset, size_t count) {
+  nor_flash_erase(offset, count);
+}
+
+static inline void flash_range_program(uint32_t offset, const uint8_t *data,
+                                       size_t count) {
+  nor_flash_program(offset, data, count);
+}
+
+#endif // BENCH_HARDWARE_FLASH_H
@@ -0,0 +1 @@
+// Included by settings.h. Nothing is used on the host
@@ -0,0 +1,12 @@
+// Host version of the interrupt functions of the Pico SDK. There are no
+// interrupts to disable
+#ifndef BENCH_HARDWARE_SYNC_H
+#define BENCH_HARDWARE_SYNC_H
+
+#include <stdint.h>
+
+static inline uint32_t save_and_disable_interrupts() { return 0; }
+
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+
+#endif // BENCH_HARDWARE_SYNC_H
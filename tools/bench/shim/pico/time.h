@@ -0,0 +1,14 @@
+// Host version of the time functions of the Pico SDK
+#ifndef BENCH_PICO_TIME_H
+#define BENCH_PICO_TIME_H
+
+#include <stdint.h>
+#include <time.h>
+
+static inline uint64_t time_us_64() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+#endif // BENCH_PICO_TIME_H
@@ -0,0 +1,96 @@
+// FlashDB store of the benchmark: a key-value database in a FAL partition.
+// Built when the FlashDB submodule is checked out, or with
+// make FLASHDB_DIR=<path to FlashDB>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "flashdb.h"
+#include "nor_flash.h"
+
+static struct fdb_kvdb kvdb;
+static bool initialized = false;
+static uint32_t regionOffset = 0;
+
+static int fdbFlashInit() { return 0; }
+
+// The offsets are relative to the device, which starts at the region
+static int fdbFlashRead(long offset, uint8_t *buf, size_t size) {
+  nor_flash_read(regionOffset + (uint32_t)offset, buf, size);
+  return (int)size;
+}
+
+static int fdbFlashWrite(long offset, const uint8_t *buf, size_t size) {
+  // FlashDB writes across pages, the flash programs page by page
+  uint32_t address = regionOffset + (uint32_t)offset;
+  size_t done = 0;
+  while (done < size) {
+    size_t chunk = NOR_PAGE_SIZE - (address + done) % NOR_PAGE_SIZE;
+    chunk = chunk < size - done ? chunk : size - done;
+    if (nor_flash_program(address + done, buf + done, chunk) != 0) {
+      return -1;
+    }
+    done += chunk;
+  }
+  return (int)size;
+}
+
+static int fdbFlashErase(long offset, size_t size) {
+  return nor_flash_erase(regionOffset + (uint32_t)offset, size) == 0
+             ? (int)size
+             : -1;
+}
+
+const struct fal_flash_dev bench_nor_flash = {
+    .name = BENCH_FAL_FLASH_NAME,
+    .addr = 0,
+    .len = BENCH_FAL_PART_SIZE,
+    .blk_size = NOR_SECTOR_SIZE,
+    .ops = {fdbFlashInit, fdbFlashRead, fdbFlashWrite, fdbFlashErase},
+    .write_gran = 1};
+
+static int flashdbSetup(unsigned numKeys, uint32_t offset, uint32_t size) {
+  regionOffset = offset;
+  initialized = false;
+  return size >= BENCH_FAL_PART_SIZE ? 0 : -1;
+}
+
+static int flashdbBoot() {
+  if (initialized) {
+    fdb_kvdb_deinit(&kvdb);
+    initialized = false;
+  }
+  fal_init();
+  memset(&kvdb, 0, sizeof(kvdb));
+  if (fdb_kvdb_init(&kvdb, "bench", BENCH_FAL_PART_NAME, NULL, NULL) !=
+      FDB_NO_ERR) {
+    return -1;
+  }
+  initialized = true;
+  return 0;
+}
+
+static int flashdbGet(const char *key, char *value, size_t size) {
+  struct fdb_blob blob;
+  size_t len =
+      fdb_kv_get_blob(&kvdb, key, fdb_blob_make(&blob, value, size - 1));
+  if (len == 0) {
+    return -1;
+  }
+  value[len] = '\0';
+  return 0;
+}
+
+static int flashdbPut(const char *key, const char *value) {
+  return fdb_kv_set(&kvdb, key, value) == FDB_NO_ERR ? 0 : -1;
+}
+
+// Every set is already committed
+static int flashdbCommit() { return 0; }
+
+const BenchStore bench_flashdb_store = {.name = "FlashDB",
+                                        .setup = flashdbSetup,
+                                        .boot = flashdbBoot,
+                                        .get = flashdbGet,
+                                        .put = flashdbPut,
+                                        .commit = flashdbCommit};
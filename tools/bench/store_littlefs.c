@@ -0,0 +1,106 @@
+// littlefs store of the benchmark: one file per key. Built when the littlefs
+// submodule is checked out, or with make LITTLEFS_DIR=<path to littlefs>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "lfs.h"
+#include "nor_flash.h"
+
+static lfs_t lfs;
+static bool mounted = false;
+static uint32_t regionOffset = 0;
+
+static int lfsRead(const struct lfs_config *config, lfs_block_t block,
+                   lfs_off_t off, void *buffer, lfs_size_t size) {
+  nor_flash_read(regionOffset + block * config->block_size + off,
+                 (uint8_t *)buffer, size);
+  return 0;
+}
+
+static int lfsProg(const struct lfs_config *config, lfs_block_t block,
+                   lfs_off_t off, const void *buffer, lfs_size_t size) {
+  // The program size is the page size, so programs never cross a page
+  return nor_flash_program(regionOffset + block * config->block_size + off,
+                           (const uint8_t *)buffer, size) == 0
+             ? 0
+             : LFS_ERR_IO;
+}
+
+static int lfsErase(const struct lfs_config *config, lfs_block_t block) {
+  return nor_flash_erase(regionOffset + block * config->block_size,
+                         config->block_size) == 0
+             ? 0
+             : LFS_ERR_IO;
+}
+
+static int lfsSync(const struct lfs_config *config) { return 0; }
+
+static struct lfs_config lfsConfig = {.read = lfsRead,
+                                      .prog = lfsProg,
+                                      .erase = lfsErase,
+                                      .sync = lfsSync,
+                                      .read_size = 16,
+                                      .prog_size = NOR_PAGE_SIZE,
+                                      .block_size = NOR_SECTOR_SIZE,
+                                      .cache_size = NOR_PAGE_SIZE,
+                                      .lookahead_size = 16,
+                                      .block_cycles = 500};
+
+static int littlefsSetup(unsigned numKeys, uint32_t offset, uint32_t size) {
+  regionOffset = offset;
+  lfsConfig.block_count = size / NOR_SECTOR_SIZE;
+  mounted = false;
+  return 0;
+}
+
+static int littlefsBoot() {
+  if (mounted) {
+    lfs_unmount(&lfs);
+    mounted = false;
+  }
+  if (lfs_mount(&lfs, &lfsConfig) != 0) {
+    if (lfs_format(&lfs, &lfsConfig) != 0 ||
+        lfs_mount(&lfs, &lfsConfig) != 0) {
+      return -1;
+    }
+  }
+  mounted = true;
+  return 0;
+}
+
+static int littlefsGet(const char *key, char *value, size_t size) {
+  lfs_file_t file;
+  if (lfs_file_open(&lfs, &file, key, LFS_O_RDONLY) != 0) {
+    return -1;
+  }
+  lfs_ssize_t len = lfs_file_read(&lfs, &file, value, size - 1);
+  lfs_file_close(&lfs, &file);
+  if (len < 0) {
+    return -1;
+  }
+  value[len] = '\0';
+  return 0;
+}
+
+static int littlefsPut(const char *key, const char *value) {
+  lfs_file_t file;
+  if (lfs_file_open(&lfs, &file, key,
+                    LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != 0) {
+    return -1;
+  }
+  lfs_ssize_t len = (lfs_ssize_t)strlen(value);
+  lfs_ssize_t written = lfs_file_write(&lfs, &file, value, len);
+  // Closing the file commits it
+  return lfs_file_close(&lfs, &file) == 0 && written == len ? 0 : -1;
+}
+
+// Every put is already committed
+static int littlefsCommit() { return 0; }
+
+const BenchStore bench_littlefs_store = {.name = "littlefs",
+                                         .setup = littlefsSetup,
+                                         .boot = littlefsBoot,
+                                         .get = littlefsGet,
+                                         .put = littlefsPut,
+                                         .commit = littlefsCommit};
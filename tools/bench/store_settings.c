@@ -0,0 +1,67 @@
+// rp-settings store of the benchmark: every key is a string setting, in the
+// smallest region that holds them, saved by commit.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "settings.h"
+
+#define BENCH_SETTINGS_MAGIC 0x4BE5
+#define BENCH_SETTINGS_VERSION 1
+
+static SettingsConfigEntry *defaults = NULL;
+static unsigned defaultsCount = 0;
+static uint32_t regionOffset = 0;
+static uint32_t regionSize = 0;
+
+static int settingsSetup(unsigned numKeys, uint32_t offset, uint32_t size) {
+  free(defaults);
+  defaults =
+      (SettingsConfigEntry *)calloc(numKeys, sizeof(SettingsConfigEntry));
+  if (defaults == NULL) {
+    return -1;
+  }
+  for (unsigned i = 0; i < numKeys; i++) {
+    bench_key(i, defaults[i].key);
+    defaults[i].dataType = SETTINGS_TYPE_STRING;
+    bench_initial_value(i, defaults[i].value);
+  }
+  defaultsCount = numKeys;
+
+  // The smallest region for the keys, the magic entry and the end mark
+  uint32_t needed = (numKeys + 2) * sizeof(SettingsConfigEntry);
+  regionOffset = offset;
+  regionSize = (needed + SETTINGS_FLASH_PAGE_SIZE - 1) /
+               SETTINGS_FLASH_PAGE_SIZE * SETTINGS_FLASH_PAGE_SIZE;
+  return regionSize <= size ? 0 : -1;
+}
+
+static int settingsBoot() {
+  // A negative result is a first boot, with the default values
+  settings_init(defaults, defaultsCount, regionOffset, regionSize,
+                BENCH_SETTINGS_MAGIC, BENCH_SETTINGS_VERSION);
+  return 0;
+}
+
+static int settingsGet(const char *key, char *value, size_t size) {
+  SettingsConfigEntry *entry = settings_find_entry(key);
+  if (entry == NULL) {
+    return -1;
+  }
+  snprintf(value, size, "%s", entry->value);
+  return 0;
+}
+
+static int settingsPut(const char *key, const char *value) {
+  return settings_put_string(key, value);
+}
+
+static int settingsCommit() { return settings_save(); }
+
+const BenchStore bench_settings_store = {.name = "rp-settings",
+                                         .setup = settingsSetup,
+                                         .boot = settingsBoot,
+                                         .get = settingsGet,
+                                         .put = settingsPut,
+                                         .commit = settingsCommit};
@@ -0,0 +1,690 @@
+/**
+ * @file settings_fleet.c
+ * @author Diego Parrilla
+ * @date October 2026
+ * @copyright 2026 - GOODDATA LABS SL
+ *
+ * @brief Analyzer of the settings dumps collected from a fleet of units.
+ *
+ * A dump is the raw content of the settings region of a unit, in the format
+ * written by settings_save(): an array of SettingsConfigEntry records, the
+ * magic entry first, ended by a record with an empty key or by the end of
+ * the region. The dumps are memory mapped and decoded in parallel, and the
+ * aggregated statistics are printed as CSV: the state of the dumps, the mix
+ * of magic values and versions, the estimated wear of the flash and the
+ * distribution of the values of each key.
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Layout of SettingsConfigEntry, as in settings.h. The size of the data type
+// depends on the compiler: one byte with the short enums of arm-none-eabi,
+// four bytes aligned otherwise
+#define FLEET_KEY_LENGTH 30
+#define FLEET_VALUE_LENGTH 96
+#define FLEET_TYPE_OFFSET_SHORT 30
+#define FLEET_VALUE_OFFSET_SHORT 31
+#define FLEET_RECORD_SIZE_SHORT 127
+#define FLEET_TYPE_OFFSET_INT 32
+#define FLEET_VALUE_OFFSET_INT 36
+#define FLEET_RECORD_SIZE_INT 132
+
+#define FLEET_MAGICVERSION_KEY "MAGICVERSION"
+#define FLEET_GENERATION_SEPARATOR ':'
+
+#define FLEET_TYPE_INT 0
+#define FLEET_TYPE_STRING 1
+#define FLEET_TYPE_BOOL 2
+
+#define FLEET_DEFAULT_ENDURANCE 100000
+#define FLEET_DEFAULT_TOP 10
+#define FLEET_MAX_VERSIONS 256
+#define FLEET_VALUES_INITIAL_CAPACITY 4096
+// Dumps taken by a thread at a time
+#define FLEET_BATCH 64
+
+// State of a dump
+typedef enum {
+  FLEET_VALID = 0,  ///< Magic entry and records up to the end mark
+  FLEET_BLANK,      ///< Erased region, the unit never saved its settings
+  FLEET_NO_MAGIC,   ///< The first record is not a magic entry
+  FLEET_TORN,       ///< Erased records before the end mark: a cut save
+  FLEET_INVALID,    ///< Records that are neither valid nor erased
+  FLEET_STATES
+} FleetState;
+
+static const char *stateNames[FLEET_STATES] = {"valid", "blank", "no_magic",
+                                               "torn", "invalid"};
+
+typedef struct {
+  const uint8_t *data;
+  size_t size;
+} FleetDump;
+
+typedef struct {
+  uint16_t magic;
+  uint16_t version;
+  uint64_t dumps;
+} FleetVersion;
+
+// Number of dumps with a value of a key. A free slot has no dumps
+typedef struct {
+  uint64_t hash;
+  uint64_t dumps;
+  uint8_t type;
+  char key[FLEET_KEY_LENGTH + 1];
+  char value[FLEET_VALUE_LENGTH + 1];
+} FleetValue;
+
+typedef struct {
+  FleetValue *slots;
+  size_t capacity;
+  size_t used;
+} FleetValueTable;
+
+// Statistics of the dumps decoded by a thread, merged at the end
+typedef struct {
+  uint64_t states[FLEET_STATES];
+  uint64_t records;
+  FleetVersion versions[FLEET_MAX_VERSIONS];
+  size_t numVersions;
+  uint64_t otherVersions;
+  FleetValueTable values;
+  int error;
+} FleetStats;
+
+typedef struct {
+  unsigned threads;
+  size_t dumpSize;
+  size_t recordSize;
+  long magic;
+  uint32_t endurance;
+  unsigned top;
+} FleetOptions;
+
+static FleetOptions options = {.threads = 0,
+                               .dumpSize = 0,
+                               .recordSize = 0,
+                               .magic = -1,
+                               .endurance = FLEET_DEFAULT_ENDURANCE,
+                               .top = FLEET_DEFAULT_TOP};
+
+static FleetDump *dumps = NULL;
+static size_t numDumps = 0;
+static size_t dumpsCapacity = 0;
+static uint64_t mappedBytes = 0;
+// Generation of each valid dump, or UINT32_MAX
+static uint32_t *generations = NULL;
+static atomic_size_t nextDump = 0;
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t len) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+static int valueTableInit(FleetValueTable *table, size_t capacity) {
+  table->slots = (FleetValue *)calloc(capacity, sizeof(FleetValue));
+  table->capacity = capacity;
+  table->used = 0;
+  return table->slots != NULL ? 0 : -1;
+}
+
+static FleetValue *valueTableSlot(FleetValueTable *table, uint64_t hash,
+                                  uint8_t type, const char *key,
+                                  const char *value) {
+  size_t slot = hash & (table->capacity - 1);
+  while (table->slots[slot].dumps != 0) {
+    FleetValue *entry = &table->slots[slot];
+    if (entry->hash == hash && entry->type == type &&
+        strcmp(entry->key, key) == 0 && strcmp(entry->value, value) == 0) {
+      break;
+    }
+    slot = (slot + 1) & (table->capacity - 1);
+  }
+  return &table->slots[slot];
+}
+
+// Add dumps to the count of a value, growing the table at 70% of use
+static int valueTableAdd(FleetValueTable *table, uint64_t hash, uint8_t type,
+                         const char *key, const char *value, uint64_t count) {
+  if ((table->used + 1) * 10 > table->capacity * 7) {
+    FleetValueTable grown;
+    if (valueTableInit(&grown, table->capacity * 2) != 0) {
+      return -1;
+    }
+    for (size_t i = 0; i < table->capacity; i++) {
+      FleetValue *entry = &table->slots[i];
+      if (entry->dumps != 0) {
+        *valueTableSlot(&grown, entry->hash, entry->type, entry->key,
+                        entry->value) = *entry;
+      }
+    }
+    grown.used = table->used;
+    free(table->slots);
+    *table = grown;
+  }
+  FleetValue *entry = valueTableSlot(table, hash, type, key, value);
+  if (entry->dumps == 0) {
+    entry->hash = hash;
+    entry->type = type;
+    strcpy(entry->key, key);
+    strcpy(entry->value, value);
+    table->used++;
+  }
+  entry->dumps += count;
+  return 0;
+}
+
+static void countVersion(FleetStats *stats, uint16_t magic, uint16_t version,
+                         uint64_t count) {
+  for (size_t i = 0; i < stats->numVersions; i++) {
+    if (stats->versions[i].magic == magic &&
+        stats->versions[i].version == version) {
+      stats->versions[i].dumps += count;
+      return;
+    }
+  }
+  if (stats->numVersions == FLEET_MAX_VERSIONS) {
+    stats->otherVersions += count;
+    return;
+  }
+  stats->versions[stats->numVersions++] =
+      (FleetVersion){.magic = magic, .version = version, .dumps = count};
+}
+
+// Same rules as checkKeyFormat() of the library, plus the terminator
+static bool validKey(const uint8_t *record) {
+  if (record[0] == '\0' || memchr(record, '\0', FLEET_KEY_LENGTH) == NULL) {
+    return false;
+  }
+  for (const uint8_t *chr = record; *chr != '\0'; chr++) {
+    if (!isupper(*chr) && !isdigit(*chr) && *chr != '_') {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool erasedRecord(const uint8_t *record, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    if (record[i] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static unsigned recordType(const uint8_t *record, size_t recordSize) {
+  if (recordSize == FLEET_RECORD_SIZE_SHORT) {
+    return record[FLEET_TYPE_OFFSET_SHORT];
+  }
+  const uint8_t *type = record + FLEET_TYPE_OFFSET_INT;
+  return (unsigned)type[0] | (unsigned)type[1] << 8 |
+         (unsigned)type[2] << 16 | (unsigned)type[3] << 24;
+}
+
+// Copy the value of a record, which may not be terminated
+static void recordValue(const uint8_t *record, size_t recordSize,
+                        char *value) {
+  const uint8_t *start =
+      record + (recordSize == FLEET_RECORD_SIZE_SHORT ? FLEET_VALUE_OFFSET_SHORT
+                                                      : FLEET_VALUE_OFFSET_INT);
+  size_t len = strnlen((const char *)start, FLEET_VALUE_LENGTH);
+  memcpy(value, start, len);
+  value[len] = '\0';
+}
+
+// Size of the records of a dump, from the layout of its magic entry
+static size_t detectRecordSize(const uint8_t *data, size_t size) {
+  if (options.recordSize != 0) {
+    return options.recordSize;
+  }
+  if (size >= FLEET_RECORD_SIZE_SHORT &&
+      data[FLEET_TYPE_OFFSET_SHORT] <= FLEET_TYPE_BOOL &&
+      isdigit(data[FLEET_VALUE_OFFSET_SHORT])) {
+    return FLEET_RECORD_SIZE_SHORT;
+  }
+  return FLEET_RECORD_SIZE_INT;
+}
+
+static void decodeDump(FleetStats *stats, size_t index) {
+  const uint8_t *data = dumps[index].data;
+  size_t size = dumps[index].size;
+  generations[index] = UINT32_MAX;
+  if (erasedRecord(data, size)) {
+    stats->states[FLEET_BLANK]++;
+    return;
+  }
+
+  // The magic entry: "<magic << 16 | version>:<generation>"
+  size_t recordSize = detectRecordSize(data, size);
+  char value[FLEET_VALUE_LENGTH + 1];
+  if (size < recordSize || !validKey(data) ||
+      strcmp((const char *)data, FLEET_MAGICVERSION_KEY) != 0 ||
+      recordType(data, recordSize) > FLEET_TYPE_BOOL) {
+    stats->states[FLEET_NO_MAGIC]++;
+    return;
+  }
+  recordValue(data, recordSize, value);
+  char *end = NULL;
+  uint32_t magic = (uint32_t)strtoul(value, &end, 10);
+  if (end == value || (options.magic >= 0 && magic != options.magic)) {
+    stats->states[FLEET_NO_MAGIC]++;
+    return;
+  }
+  uint32_t generation = *end == FLEET_GENERATION_SEPARATOR
+                            ? (uint32_t)strtoul(end + 1, NULL, 10)
+                            : 0;
+
+  // The rest of the records, up to the end mark or the end of the region
+  FleetState state = FLEET_VALID;
+  size_t numRecords = size / recordSize;
+  size_t record = 1;
+  for (; record < numRecords; record++) {
+    const uint8_t *entry = data + record * recordSize;
+    if (entry[0] == '\0') {
+      break;
+    }
+    if (erasedRecord(entry, recordSize)) {
+      state = FLEET_TORN;
+      break;
+    }
+    unsigned type = recordType(entry, recordSize);
+    if (!validKey(entry) || type > FLEET_TYPE_BOOL) {
+      state = FLEET_INVALID;
+      break;
+    }
+    recordValue(entry, recordSize, value);
+    const char *key = (const char *)entry;
+    uint64_t hash = hashBytes(hashBytes(0xCBF29CE484222325ULL + type, key,
+                                        strlen(key) + 1),
+                              value, strlen(value));
+    if (valueTableAdd(&stats->values, hash, (uint8_t)type, key, value, 1) !=
+        0) {
+      stats->error = -1;
+      return;
+    }
+  }
+  stats->states[state]++;
+  stats->records += record;
+  countVersion(stats, (uint16_t)(magic >> 16), (uint16_t)magic, 1);
+  if (state == FLEET_VALID) {
+    generations[index] = generation;
+  }
+}
+
+static void *fleetWorker(void *arg) {
+  FleetStats *stats = (FleetStats *)arg;
+  while (stats->error == 0) {
+    size_t first = atomic_fetch_add(&nextDump, FLEET_BATCH);
+    if (first >= numDumps) {
+      break;
+    }
+    size_t last = first + FLEET_BATCH < numDumps ? first + FLEET_BATCH
+                                                 : numDumps;
+    for (size_t i = first; i < last; i++) {
+      decodeDump(stats, i);
+    }
+  }
+  return NULL;
+}
+
+static int addDump(const uint8_t *data, size_t size) {
+  if (numDumps == dumpsCapacity) {
+    size_t capacity = dumpsCapacity != 0 ? dumpsCapacity * 2 : 1024;
+    FleetDump *grown =
+        (FleetDump *)realloc(dumps, capacity * sizeof(FleetDump));
+    if (grown == NULL) {
+      return -1;
+    }
+    dumps = grown;
+    dumpsCapacity = capacity;
+  }
+  dumps[numDumps++] = (FleetDump){.data = data, .size = size};
+  return 0;
+}
+
+// Map a file and split it in dumps. The mapping is kept until the end
+static int mapFile(const char *path) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    perror(path);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  size_t size = (size_t)st.st_size;
+  if (size == 0) {
+    close(fd);
+    return 0;
+  }
+  const uint8_t *data =
+      (const uint8_t *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    perror(path);
+    return -1;
+  }
+  madvise((void *)data, size, MADV_WILLNEED);
+  mappedBytes += size;
+  size_t dumpSize = options.dumpSize != 0 ? options.dumpSize : size;
+  if (size % dumpSize != 0) {
+    fprintf(stderr, "%s: %zu bytes is not a multiple of the dump size\n",
+            path, size);
+  }
+  for (size_t offset = 0; offset + dumpSize <= size; offset += dumpSize) {
+    if (addDump(data + offset, dumpSize) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// Map a file, or the regular files of a directory
+static int mapPath(const char *path) {
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    perror(path);
+    return -1;
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    return mapFile(path);
+  }
+  DIR *dir = opendir(path);
+  if (dir == NULL) {
+    perror(path);
+    return -1;
+  }
+  int err = 0;
+  struct dirent *dirEntry;
+  while (err == 0 && (dirEntry = readdir(dir)) != NULL) {
+    char filePath[4096];
+    snprintf(filePath, sizeof(filePath), "%s/%s", path, dirEntry->d_name);
+    if (dirEntry->d_name[0] != '.' && stat(filePath, &st) == 0 &&
+        S_ISREG(st.st_mode)) {
+      err = mapFile(filePath);
+    }
+  }
+  closedir(dir);
+  return err;
+}
+
+static void mergeStats(FleetStats *total, const FleetStats *stats) {
+  for (int i = 0; i < FLEET_STATES; i++) {
+    total->states[i] += stats->states[i];
+  }
+  total->records += stats->records;
+  for (size_t i = 0; i < stats->numVersions; i++) {
+    countVersion(total, stats->versions[i].magic, stats->versions[i].version,
+                 stats->versions[i].dumps);
+  }
+  total->otherVersions += stats->otherVersions;
+  for (size_t i = 0; i < stats->values.capacity && total->error == 0; i++) {
+    const FleetValue *entry = &stats->values.slots[i];
+    if (entry->dumps != 0) {
+      total->error = valueTableAdd(&total->values, entry->hash, entry->type,
+                                   entry->key, entry->value, entry->dumps);
+    }
+  }
+}
+
+static int compareGenerations(const void *a, const void *b) {
+  uint32_t left = *(const uint32_t *)a;
+  uint32_t right = *(const uint32_t *)b;
+  return (left > right) - (left < right);
+}
+
+// By key, then by type, then the most common values first
+static int compareValues(const void *a, const void *b) {
+  const FleetValue *left = *(const FleetValue *const *)a;
+  const FleetValue *right = *(const FleetValue *const *)b;
+  int cmp = strcmp(left->key, right->key);
+  if (cmp == 0) {
+    cmp = (int)left->type - (int)right->type;
+  }
+  if (cmp == 0) {
+    cmp = (left->dumps < right->dumps) - (left->dumps > right->dumps);
+  }
+  return cmp != 0 ? cmp : strcmp(left->value, right->value);
+}
+
+// Print a value as a CSV field: quoted, with the quotes doubled and the
+// control characters replaced
+static void printCsvValue(const char *value) {
+  putchar('"');
+  for (const char *chr = value; *chr != '\0'; chr++) {
+    if (*chr == '"') {
+      putchar('"');
+    }
+    putchar(iscntrl((unsigned char)*chr) ? '?' : *chr);
+  }
+  putchar('"');
+}
+
+static void printStates(const FleetStats *total) {
+  printf("state,dumps,percent\n");
+  for (int i = 0; i < FLEET_STATES; i++) {
+    printf("%s,%llu,%.2f\n", stateNames[i],
+           (unsigned long long)total->states[i],
+           numDumps != 0 ? 100.0 * total->states[i] / numDumps : 0.0);
+  }
+}
+
+static void printVersions(const FleetStats *total) {
+  printf("\nmagic,version,dumps\n");
+  for (size_t i = 0; i < total->numVersions; i++) {
+    printf("%u,%u,%llu\n", total->versions[i].magic,
+           total->versions[i].version,
+           (unsigned long long)total->versions[i].dumps);
+  }
+  if (total->otherVersions != 0) {
+    printf("other,other,%llu\n", (unsigned long long)total->otherVersions);
+  }
+}
+
+// The generation counts the saves, and every save erases the first sector
+// of the region, the one of the magic entry. It is the most worn one
+static void printWear() {
+  size_t count = 0;
+  for (size_t i = 0; i < numDumps; i++) {
+    if (generations[i] != UINT32_MAX) {
+      generations[count++] = generations[i];
+    }
+  }
+  printf("\ndumps,generation_min,generation_p50,generation_p90,"
+         "generation_p99,generation_max,endurance,worn_10pct,worn_50pct,"
+         "worn_90pct\n");
+  if (count == 0) {
+    printf("0,,,,,,%u,0,0,0\n", options.endurance);
+    return;
+  }
+  qsort(generations, count, sizeof(uint32_t), compareGenerations);
+  size_t worn[3] = {0};
+  const unsigned wornPercent[3] = {10, 50, 90};
+  for (size_t i = 0; i < count; i++) {
+    for (int j = 0; j < 3; j++) {
+      worn[j] += (uint64_t)generations[i] * 100 >=
+                 (uint64_t)options.endurance * wornPercent[j];
+    }
+  }
+  printf("%zu,%u,%u,%u,%u,%u,%u,%zu,%zu,%zu\n", count, generations[0],
+         generations[count / 2], generations[count * 90 / 100],
+         generations[count * 99 / 100], generations[count - 1],
+         options.endurance, worn[0], worn[1], worn[2]);
+}
+
+// The most common values of each key, and the number of dumps with any
+// other value
+static int printValues(const FleetStats *total) {
+  const FleetValueTable *table = &total->values;
+  FleetValue **sorted =
+      (FleetValue **)malloc((table->used + 1) * sizeof(FleetValue *));
+  if (sorted == NULL) {
+    return -1;
+  }
+  size_t count = 0;
+  for (size_t i = 0; i < table->capacity; i++) {
+    if (table->slots[i].dumps != 0) {
+      sorted[count++] = &table->slots[i];
+    }
+  }
+  qsort(sorted, count, sizeof(FleetValue *), compareValues);
+
+  static const char *typeNames[] = {"INT", "STRING", "BOOL"};
+  printf("\nkey,type,value,dumps\n");
+  size_t first = 0;
+  while (first < count) {
+    size_t last = first;
+    while (last < count && sorted[last]->type == sorted[first]->type &&
+           strcmp(sorted[last]->key, sorted[first]->key) == 0) {
+      last++;
+    }
+    uint64_t others = 0;
+    for (size_t i = first; i < last; i++) {
+      const FleetValue *entry = sorted[i];
+      if (i - first >= options.top) {
+        others += entry->dumps;
+        continue;
+      }
+      printf("%s,%s,", entry->key, typeNames[entry->type]);
+      printCsvValue(entry->value);
+      printf(",%llu\n", (unsigned long long)entry->dumps);
+    }
+    if (others != 0) {
+      printf("%s,%s,<%zu other values>,%llu\n", sorted[first]->key,
+             typeNames[sorted[first]->type], last - first - options.top,
+             (unsigned long long)others);
+    }
+    first = last;
+  }
+  free(sorted);
+  return 0;
+}
+
+static void usage(FILE *out, const char *program) {
+  fprintf(out,
+          "Usage: %s [-h] [-j threads] [-s dump size] [-r 127|132] "
+          "[-m magic] [-e endurance] [-t top values] FILE|DIR...\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  int opt;
+  while ((opt = getopt(argc, argv, "hj:s:r:m:e:t:")) != -1) {
+    switch (opt) {
+      case 'h':
+        usage(stdout, argv[0]);
+        return 0;
+      case 'j':
+        options.threads = (unsigned)strtoul(optarg, NULL, 0);
+        break;
+      case 's':
+        options.dumpSize = (size_t)strtoul(optarg, NULL, 0);
+        break;
+      case 'r':
+        options.recordSize = (size_t)strtoul(optarg, NULL, 0);
+        break;
+      case 'm':
+        options.magic = (long)strtoul(optarg, NULL, 0);
+        break;
+      case 'e':
+        options.endurance = (uint32_t)strtoul(optarg, NULL, 0);
+        break;
+      case 't':
+        options.top = (unsigned)strtoul(optarg, NULL, 0);
+        break;
+      default:
+        usage(stderr, argv[0]);
+        return 2;
+    }
+  }
+  if (optind == argc || options.endurance == 0 ||
+      (options.recordSize != 0 &&
+       options.recordSize != FLEET_RECORD_SIZE_SHORT &&
+       options.recordSize != FLEET_RECORD_SIZE_INT)) {
+    usage(stderr, argv[0]);
+    return 2;
+  }
+  if (options.threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    options.threads = cpus > 0 ? (unsigned)cpus : 1;
+  }
+
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = optind; i < argc; i++) {
+    if (mapPath(argv[i]) != 0) {
+      return 1;
+    }
+  }
+  generations = (uint32_t *)malloc((numDumps + 1) * sizeof(uint32_t));
+  FleetStats *stats = (FleetStats *)calloc(options.threads, sizeof(FleetStats));
+  pthread_t *threads =
+      (pthread_t *)calloc(options.threads, sizeof(pthread_t));
+  if (generations == NULL || stats == NULL || threads == NULL) {
+    return 1;
+  }
+
+  unsigned started = 0;
+  for (; started < options.threads; started++) {
+    if (valueTableInit(&stats[started].values,
+                       FLEET_VALUES_INITIAL_CAPACITY) != 0 ||
+        pthread_create(&threads[started], NULL, fleetWorker,
+                       &stats[started]) != 0) {
+      break;
+    }
+  }
+  if (started == 0) {
+    return 1;
+  }
+  for (unsigned i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  // A worker that failed stopped early, so the totals would miss dumps
+  int error = 0;
+  for (unsigned i = 0; i < started; i++) {
+    error |= stats[i].error;
+  }
+  for (unsigned i = 1; i < started && error == 0; i++) {
+    mergeStats(&stats[0], &stats[i]);
+    error = stats[0].error;
+  }
+  if (error != 0) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  printStates(&stats[0]);
+  printVersions(&stats[0]);
+  printWear();
+  if (printValues(&stats[0]) != 0) {
+    return 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (double)(end.tv_sec - start.tv_sec) +
+                   (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+  fprintf(stderr, "%zu dumps, %llu records, %.1f MB in %.2f s, %u threads\n",
+          numDumps, (unsigned long long)stats[0].records,
+          mappedBytes / 1e6, seconds, started);
+  return 0;
+}
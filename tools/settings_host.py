@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+"""Reference host client of the framed binary protocol of the settings CLI.
+
+The frame layout and the opcodes are described in examples/protocol.h.
+
+Usage:
+    settings_host.py PORT ping
+    settings_host.py PORT get KEY [KEY...]
+    settings_host.py PORT put KEY=VALUE [KEY=VALUE...] [--save]
+    settings_host.py PORT save
+    settings_host.py PORT export [json|cbor] [-o FILE]
+    settings_host.py PORT stats
+
+PUT reads the type of each key with a GET first, so values are sent with the
+type the firmware expects. Requires pyserial.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+SOF = 0x01
+RESPONSE_FLAG = 0x80
+MAX_PAYLOAD = 1024
+
+OP_PING = 0x01
+OP_GET = 0x02
+OP_PUT = 0x03
+OP_SAVE = 0x04
+OP_EXPORT = 0x05
+OP_STATS = 0x06
+
+STATUS_OK = 0x00
+STATUS_MORE = 0x01
+STATUS_NAMES = {0x02: "error", 0x03: "bad frame", 0x04: "unknown opcode"}
+
+TYPE_INT = 0
+TYPE_STRING = 1
+TYPE_BOOL = 2
+TYPE_UNKNOWN = 0xFF
+TYPE_NAMES = {TYPE_INT: "INT", TYPE_STRING: "STRING", TYPE_BOOL: "BOOL"}
+
+FORMATS = {"json": 0, "cbor": 1}
+
+STATS_FIELDS = ("entries", "maxEntries", "persistedEntries", "flashOffset",
+                "flashSize", "generation", "lastSaveUs", "lastSaveIrqOffUs")
+
+
+class ProtocolError(Exception):
+    """The device answered with an error or a malformed frame."""
+
+
+class SettingsClient:
+    """Sends requests and reads responses over any byte stream.
+
+    The stream needs read(n) and write(data), like serial.Serial.
+    """
+
+    def __init__(self, stream):
+        self.stream = stream
+
+    def _read_exact(self, size):
+        data = b""
+        while len(data) < size:
+            chunk = self.stream.read(size - len(data))
+            if not chunk:
+                raise ProtocolError("timeout waiting for the device")
+            data += chunk
+        return data
+
+    def _send(self, opcode, payload=b""):
+        if len(payload) > MAX_PAYLOAD:
+            raise ProtocolError("payload too long")
+        body = struct.pack("<HB", len(payload), opcode) + payload
+        crc = zlib.crc32(body) & 0xFFFFFFFF
+        self.stream.write(bytes([SOF]) + body + struct.pack("<I", crc))
+
+    def _receive_frame(self, opcode):
+        # Skip any text printed by the firmware until the start of a frame
+        while self._read_exact(1)[0] != SOF:
+            pass
+        header = self._read_exact(3)
+        length, response_opcode = struct.unpack("<HB", header)
+        payload = self._read_exact(length)
+        (crc,) = struct.unpack("<I", self._read_exact(4))
+        if zlib.crc32(header + payload) & 0xFFFFFFFF != crc:
+            raise ProtocolError("bad CRC in response")
+        if response_opcode != opcode | RESPONSE_FLAG or length == 0:
+            raise ProtocolError("unexpected response 0x%02x" % response_opcode)
+        return payload[0], payload[1:]
+
+    def request(self, opcode, payload=b""):
+        """Send a request and return the data of all its response frames."""
+        self._send(opcode, payload)
+        data = b""
+        while True:
+            status, chunk = self._receive_frame(opcode)
+            data += chunk
+            if status == STATUS_MORE:
+                continue
+            if status != STATUS_OK:
+                raise ProtocolError(STATUS_NAMES.get(status, "status %d" % status),
+                                    data)
+            return data
+
+    def ping(self):
+        return self.request(OP_PING)[0]
+
+    def get(self, keys):
+        """Return {key: (type, value)}. Unknown keys have type None."""
+        payload = b"".join(bytes([len(k)]) + k.encode() for k in keys)
+        data = self.request(OP_GET, payload)
+        result = {}
+        pos = 0
+        while pos < len(data):
+            value_type, key_len = data[pos], data[pos + 1]
+            pos += 2
+            key = data[pos:pos + key_len].decode()
+            pos += key_len
+            value_len = data[pos]
+            pos += 1
+            value = data[pos:pos + value_len].decode("latin-1")
+            pos += value_len
+            result[key] = (None if value_type == TYPE_UNKNOWN else value_type,
+                           value)
+        return result
+
+    def put(self, records):
+        """Set [(key, type, value)] and return (applied, failed)."""
+        payload = b""
+        for key, value_type, value in records:
+            key_bytes = key.encode()
+            value_bytes = value.encode("latin-1")
+            payload += bytes([value_type, len(key_bytes)]) + key_bytes
+            payload += bytes([len(value_bytes)]) + value_bytes
+        try:
+            data = self.request(OP_PUT, payload)
+        except ProtocolError as err:
+            if len(err.args) > 1 and len(err.args[1]) == 4:
+                return struct.unpack("<HH", err.args[1])
+            raise
+        return struct.unpack("<HH", data)
+
+    def save(self):
+        self.request(OP_SAVE)
+
+    def export(self, fmt="json"):
+        return self.request(OP_EXPORT, bytes([FORMATS[fmt]]))
+
+    def stats(self):
+        values = struct.unpack("<HHHIIIII", self.request(OP_STATS))
+        return dict(zip(STATS_FIELDS, values))
+
+
+def typed_value(value_type, text):
+    """Normalize a value typed by the user to the text stored on the device."""
+    if value_type == TYPE_INT:
+        return str(int(text, 0))
+    if value_type == TYPE_BOOL:
+        lower = text.lower()
+        if lower in ("true", "t", "1"):
+            return "true"
+        if lower in ("false", "f", "0"):
+            return "false"
+        raise ValueError("invalid boolean %r" % text)
+    return text
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="serial port of the device")
+    parser.add_argument("--baud", type=int, default=115200)
+    sub = parser.add_subparsers(dest="command", required=True)
+    sub.add_parser("ping")
+    get = sub.add_parser("get")
+    get.add_argument("keys", nargs="+")
+    put = sub.add_parser("put")
+    put.add_argument("pairs", nargs="+", metavar="KEY=VALUE")
+    put.add_argument("--save", action="store_true", help="save after put")
+    sub.add_parser("save")
+    export = sub.add_parser("export")
+    export.add_argument("format", nargs="?", choices=FORMATS, default="json")
+    export.add_argument("-o", "--output", help="write to a file")
+    sub.add_parser("stats")
+    args = parser.parse_args()
+
+    import serial  # pylint: disable=import-outside-toplevel
+
+    with serial.Serial(args.port, args.baud, timeout=2) as port:
+        client = SettingsClient(port)
+        if args.command == "ping":
+            print("protocol version %d" % client.ping())
+        elif args.command == "get":
+            for key, (value_type, value) in client.get(args.keys).items():
+                if value_type is None:
+                    print("%s: not found" % key, file=sys.stderr)
+                else:
+                    print("%s=%s" % (key, value))
+        elif args.command == "put":
+            pairs = [pair.split("=", 1) for pair in args.pairs]
+            if any(len(pair) != 2 for pair in pairs):
+                parser.error("expected KEY=VALUE")
+            types = client.get([key for key, _ in pairs])
+            records = []
+            for key, value in pairs:
+                value_type = types[key][0]
+                if value_type is None:
+                    parser.error("unknown key %s" % key)
+                records.append((key, value_type, typed_value(value_type, value)))
+            applied, failed = client.put(records)
+            print("applied %d, failed %d" % (applied, failed))
+            if args.save:
+                client.save()
+            if failed:
+                sys.exit(1)
+        elif args.command == "save":
+            client.save()
+        elif args.command == "export":
+            data = client.export(args.format)
+            if args.output:
+                with open(args.output, "wb") as output:
+                    output.write(data)
+            else:
+                sys.stdout.buffer.write(data)
+        elif args.command == "stats":
+            for name, value in client.stats().items():
+                print("%s: %d" % (name, value))
+
+
+if __name__ == "__main__":
+    main()